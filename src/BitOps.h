@@ -0,0 +1,80 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// ***************************************************************************
+// Branch-free helpers for packed pixel data. Pixels are stored MSB first,
+// i.e. the leftmost pixel of a byte is in its most significant bit(s).
+// ***************************************************************************
+
+namespace BitOps
+{
+
+/**
+ * Gathers the even bits (0, 2, ..., 14) of a 16 bit word into a byte.
+ * For 2 bpp pixel data this extracts the low bit of each of the 8 pixels.
+ */
+inline uint8_t compactEvenBits(uint16_t x)
+{
+    x &= 0x5555;
+    x = (x | (x >> 1)) & 0x3333;
+    x = (x | (x >> 2)) & 0x0f0f;
+    x = (x | (x >> 4)) & 0x00ff;
+    return (uint8_t) x;
+}
+
+/**
+ * Doubles every bit of a byte into a 16 bit word, i.e. converts 8 pixels
+ * of 1 bpp data into 2 bpp data. Inverse of compactEvenBits().
+ */
+inline uint16_t spreadBits(uint8_t b)
+{
+    uint16_t x = b;
+    x = (x | (x << 4)) & 0x0f0f;
+    x = (x | (x << 2)) & 0x3333;
+    x = (x | (x << 1)) & 0x5555;
+    return x | (x << 1);
+}
+
+/**
+ * Splits 8 pixels of 2 bpp data (two bytes, MSB first) into the 1 bpp
+ * planes holding the high and the low bit of each pixel.
+ */
+inline void splitGreyPixels(const uint8_t *src, uint8_t& highBits, uint8_t& lowBits)
+{
+    uint16_t x = ((uint16_t) src[0] << 8) | src[1];
+    highBits = compactEvenBits(x >> 1);
+    lowBits = compactEvenBits(x);
+}
+
+/**
+ * Mirrors the bit order of a byte, i.e. the order of 8 pixels of 1 bpp data.
+ */
+inline uint8_t reverseBits(uint8_t b)
+{
+    b = (b >> 4) | (b << 4);
+    b = ((b & 0xcc) >> 2) | ((b & 0x33) << 2);
+    b = ((b & 0xaa) >> 1) | ((b & 0x55) << 1);
+    return b;
+}
+
+/**
+ * Transposes an 8x8 bit matrix. Row 0 is the most significant byte, column 0
+ * the most significant bit of each row (Hacker's Delight, transpose8).
+ */
+inline uint64_t transpose8x8(uint64_t x)
+{
+    x = (x & 0xaa55aa55aa55aa55ULL) | ((x & 0x00aa00aa00aa00aaULL) << 7) | ((x >> 7) & 0x00aa00aa00aa00aaULL);
+    x = (x & 0xcccc3333cccc3333ULL) | ((x & 0x0000cccc0000ccccULL) << 14) | ((x >> 14) & 0x0000cccc0000ccccULL);
+    x = (x & 0xf0f0f0f00f0f0f0fULL) | ((x & 0x00000000f0f0f0f0ULL) << 28) | ((x >> 28) & 0x00000000f0f0f0f0ULL);
+    return x;
+}
+
+}
+
+// ***************************************************************************
@@ -0,0 +1,334 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "LayoutRenderer.h"
+#include "Sprite.h"
+#include "DisplayList.h"
+
+// ***************************************************************************
+
+static const uint8_t MAGIC[] = { 'E', 'D', 'L' };
+static const uint8_t VERSION = 1;
+
+/// Bounds checked reader for bytes and varints, sticky error flag
+class DisplayListReader
+{
+public:
+    DisplayListReader(const uint8_t *ptr, const uint8_t *end): _ptr(ptr), _end(end), _ok(true) {}
+
+    bool isOk() const { return _ok; }
+    bool isAtEnd() const { return _ptr >= _end; }
+    const uint8_t *getPtr() const { return _ptr; }
+
+    uint8_t byte()
+    {
+        if (!_ok || _ptr >= _end)
+        {
+            _ok = false;
+            return 0;
+        }
+        return *_ptr++;
+    }
+
+    uint32_t u()
+    {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            const uint8_t b = byte();
+            value |= (uint32_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return value;
+        }
+        _ok = false;
+        return 0;
+    }
+
+    int32_t s()
+    {
+        const uint32_t value = u();
+        return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    }
+
+    const uint8_t *skip(size_t n)
+    {
+        if (!_ok || (size_t)(_end - _ptr) < n)
+        {
+            _ok = false;
+            return nullptr;
+        }
+        const uint8_t *ptr = _ptr;
+        _ptr += n;
+        return ptr;
+    }
+
+private:
+    const uint8_t *_ptr;
+    const uint8_t *_end;
+    bool _ok;
+};
+
+// ***************************************************************************
+
+DisplayList::DisplayList(const uint8_t *data, size_t length, const Logger& parentLogger):
+    _data(data),
+    _length(length),
+    _commands(nullptr),
+    _width(0),
+    _height(0),
+    _logger(__FILE__, parentLogger)
+{
+    if (!isDisplayList(data, length))
+    {
+        _logger.error("Not a display list");
+        return;
+    }
+    DisplayListReader reader(data + sizeof(MAGIC) + 1, data + length);
+    _width = reader.u();
+    _height = reader.u();
+    if (!reader.isOk())
+    {
+        _logger.error("Truncated display list header");
+        return;
+    }
+    _commands = reader.getPtr();
+}
+
+bool DisplayList::isDisplayList(const uint8_t *data, size_t length)
+{
+    return length > sizeof(MAGIC) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0
+        && data[sizeof(MAGIC)] == VERSION;
+}
+
+// ***************************************************************************
+
+bool DisplayList::checkBand(const PixelBuffer& band)
+{
+    if (!isValid())
+        return false;
+    if (band.getBufPtr() == nullptr || band.getBandRows() <= 0)
+    {
+        _logger.error("No band buffer. Call PixelBuffer::allocateBand first.");
+        return false;
+    }
+    if (_width != band.width() || _height != band.height())
+    {
+        _logger.error("Display list size %dx%d does not match the panel size %dx%d",
+            _width, _height, band.width(), band.height());
+        return false;
+    }
+    return true;
+}
+
+bool DisplayList::validate(PixelBuffer& band)
+{
+    if (!checkBand(band))
+        return false;
+
+    // every replay parses all commands, a band past the panel receives no pixels
+    const int nativeHeight = (band.getRotation() & 1) ? band.width() : band.height();
+    band.selectBand(nativeHeight);
+    bool isOk = replay(band, 0, nativeHeight, 0);
+    band.resetClipRect();
+    band.setFont(nullptr);
+    band.setTextSize(1);
+    return isOk;
+}
+
+bool DisplayList::render(PixelBuffer& band, int plane, const BandSink& sink)
+{
+    if (!checkBand(band))
+        return false;
+
+    const int bandRows = band.getBandRows();
+    const int nativeHeight = (band.getRotation() & 1) ? band.width() : band.height();
+    for (int firstRow = 0; firstRow < nativeHeight; firstRow += bandRows)
+    {
+        const int numRows = (firstRow + bandRows < nativeHeight) ? bandRows : nativeHeight - firstRow;
+        band.selectBand(firstRow, plane);
+        bool isOk = replay(band, plane, firstRow, numRows);
+        band.resetClipRect();
+        band.setFont(nullptr);
+        band.setTextSize(1);
+        if (!isOk)
+            return false;
+        sink(band.getBufPtr(), firstRow, numRows);
+    }
+    return true;
+}
+
+// ***************************************************************************
+
+/**
+ * True if the logical rectangle may touch the panel rows [firstRow,
+ * firstRow + numRows) of the band, used to skip commands outside the band.
+ */
+static bool isInBand(const PixelBuffer& pb, int firstRow, int numRows, int x, int y, int w, int h)
+{
+    int top, bottom;
+    switch (pb.getRotation()) {
+    case 1: top = x; bottom = x + w; break;
+    case 2: top = pb.height() - y - h; bottom = pb.height() - y; break;
+    case 3: top = pb.width() - x - w; bottom = pb.width() - x; break;
+    default: top = y; bottom = y + h; break;
+    }
+    return bottom > firstRow && top < firstRow + numRows;
+}
+
+bool DisplayList::replay(PixelBuffer& pb, int plane, int firstRow, int numRows)
+{
+    DisplayListReader reader(_commands, _data + _length);
+    uint16_t color = pb.getPlaneValue(plane, 0, 0, 0);
+    bool isClipped = false;
+    int16_t clipX = 0, clipY = 0, clipW = 0, clipH = 0;
+
+    while (!reader.isAtEnd())
+    {
+        const uint8_t opcode = reader.byte();
+        switch (opcode) {
+        case END:
+            return true;
+
+        case COLOR: {
+            const uint8_t r = reader.byte();
+            const uint8_t g = reader.byte();
+            const uint8_t b = reader.byte();
+            color = pb.getPlaneValue(plane, r, g, b);
+            break;
+        }
+
+        case FILL:
+            if (isClipped)
+                pb.fillRect(clipX, clipY, clipW, clipH, color);
+            else
+                pb.fillScreen(color);
+            break;
+
+        case CLIP: {
+            clipX = reader.s();
+            clipY = reader.s();
+            clipW = reader.u();
+            clipH = reader.u();
+            isClipped = clipW > 0;
+            if (isClipped)
+                pb.setClipRect(clipX, clipY, clipW, clipH);
+            else
+                pb.resetClipRect();
+            break;
+        }
+
+        case LINE: {
+            const int x0 = reader.s();
+            const int y0 = reader.s();
+            const int x1 = reader.s();
+            const int y1 = reader.s();
+            const int x = x0 < x1 ? x0 : x1;
+            const int y = y0 < y1 ? y0 : y1;
+            if (isInBand(pb, firstRow, numRows, x, y, abs(x1 - x0) + 1, abs(y1 - y0) + 1))
+                pb.drawLine(x0, y0, x1, y1, color);
+            break;
+        }
+
+        case RECT:
+        case FILL_RECT: {
+            const int x = reader.s();
+            const int y = reader.s();
+            const int w = reader.u();
+            const int h = reader.u();
+            if (!isInBand(pb, firstRow, numRows, x, y, w, h))
+                break;
+            if (opcode == RECT)
+                pb.drawRect(x, y, w, h, color);
+            else
+                pb.fillRect(x, y, w, h, color);
+            break;
+        }
+
+        case CIRCLE:
+        case FILL_CIRCLE: {
+            const int x = reader.s();
+            const int y = reader.s();
+            const int r = reader.u();
+            if (!isInBand(pb, firstRow, numRows, x - r, y - r, 2 * r + 1, 2 * r + 1))
+                break;
+            if (opcode == CIRCLE)
+                pb.drawCircle(x, y, r, color);
+            else
+                pb.fillCircle(x, y, r, color);
+            break;
+        }
+
+        case TEXT: {
+            const int x = reader.s();
+            const int y = reader.s();
+            const int font = reader.u();
+            const int size = reader.u();
+            const int align = reader.u();
+            const size_t length = reader.u();
+            const uint8_t *chars = reader.skip(length);
+            if (chars == nullptr)
+                break;
+
+            char text[128];
+            const size_t n = length < sizeof(text) - 1 ? length : sizeof(text) - 1;
+            memcpy(text, chars, n);
+            text[n] = 0;
+            pb.setFont(LayoutRenderer::getFont(font));
+            pb.setTextSize(size > 0 ? size : 1);
+            pb.drawText(x, y, color, text, (PixelBuffer::TextAlign) (align <= PixelBuffer::ALIGN_RIGHT ? align : 0));
+            break;
+        }
+
+        case SPRITE: {
+            const int x = reader.s();
+            const int y = reader.s();
+            const int id = reader.u();
+            const int value = reader.s();
+            // sprites paint their background in the inverse color
+            if (color == pb.getPlaneValue(plane, 255, 255, 255))
+                break;
+            switch (id) {
+            case SPRITE_BATTERY: pb.drawSprite(x, y, StatusIcons::battery(value), color); break;
+            case SPRITE_WIFI: pb.drawSprite(x, y, StatusIcons::wifi(value), color); break;
+            case SPRITE_STALE: pb.drawStale(x, y, color); break;
+            case SPRITE_ERROR: pb.drawError(x, y, color, value); break;
+            default: break;
+            }
+            break;
+        }
+
+        case POLYLINE: {
+            const uint32_t n = reader.u();
+            int x = reader.s();
+            int y = reader.s();
+            for (uint32_t i = 1; i < n && reader.isOk(); i++)
+            {
+                const int nx = x + reader.s();
+                const int ny = y + reader.s();
+                pb.drawLine(x, y, nx, ny, color);
+                x = nx;
+                y = ny;
+            }
+            break;
+        }
+
+        default:
+            _logger.error("Unknown display list opcode 0x%02x", opcode);
+            return false;
+        }
+
+        if (!reader.isOk())
+        {
+            _logger.error("Truncated display list command 0x%02x", opcode);
+            return false;
+        }
+    }
+    return true;
+}
+
+// ***************************************************************************
@@ -0,0 +1,80 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "logger.h"
+#include "PixelBuffer.h"
+
+// ***************************************************************************
+
+/**
+ * Compact binary list of draw commands, rasterised in horizontal bands so
+ * that only a few panel rows need to be held in memory.
+ *
+ * Format: the magic "EDL", a version byte (1), the logical width and
+ * height as varints, followed by commands. Each command is an opcode byte
+ * followed by its arguments. Numbers are unsigned LEB128 varints (u);
+ * coordinates are zigzag encoded signed varints (s).
+ *
+ *   END          0x00
+ *   COLOR        0x01 r g b (bytes)        current drawing color
+ *   FILL         0x02                      fills the clip rect or the screen
+ *   CLIP         0x03 s:x s:y u:w u:h      w = 0 removes the clip rect
+ *   LINE         0x04 s:x0 s:y0 s:x1 s:y1
+ *   RECT         0x05 s:x s:y u:w u:h
+ *   FILL_RECT    0x06 s:x s:y u:w u:h
+ *   CIRCLE       0x07 s:x s:y u:r
+ *   FILL_CIRCLE  0x08 s:x s:y u:r
+ *   TEXT         0x09 s:x s:y u:font u:size u:align u:len chars
+ *   SPRITE       0x0a s:x s:y u:id s:value (battery, wifi, stale, error)
+ *   POLYLINE     0x0b u:n s:x s:y, then n-1 times s:dx s:dy
+ *
+ * Font ids are the ones of LayoutRenderer::getFont(), text is positioned
+ * by the top of its bounding box (see PixelBuffer::drawText()).
+ */
+class DisplayList
+{
+public:
+    enum Opcode {
+        END = 0x00, COLOR, FILL, CLIP, LINE, RECT, FILL_RECT, CIRCLE, FILL_CIRCLE,
+        TEXT, SPRITE, POLYLINE
+    };
+    enum SpriteId { SPRITE_BATTERY = 0, SPRITE_WIFI, SPRITE_STALE, SPRITE_ERROR };
+
+    static const int DEFAULT_BAND_ROWS = 16;
+
+    typedef PixelBuffer::BandSink BandSink;
+
+    DisplayList(const uint8_t *data, size_t length, const Logger& parentLogger = rootLogger);
+
+    static bool isDisplayList(const uint8_t *data, size_t length);
+    bool isValid() const { return _commands != nullptr; }
+
+    /**
+     * Rasterises the plane into the band buffer (see PixelBuffer::allocateBand())
+     * band by band and hands every finished band to the sink.
+     */
+    bool render(PixelBuffer& band, int plane, const BandSink& sink);
+
+    /// Parses all commands without producing a band, e.g. before powering up the panel
+    bool validate(PixelBuffer& band);
+
+private:
+    bool checkBand(const PixelBuffer& band);
+    bool replay(PixelBuffer& pb, int plane, int firstRow, int numRows);
+
+    const uint8_t *_data;
+    size_t _length;
+    const uint8_t *_commands;
+    int _width;
+    int _height;
+    Logger _logger;
+};
+
+// ***************************************************************************
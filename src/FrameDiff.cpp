@@ -0,0 +1,188 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include "FrameDiff.h"
+
+// ***************************************************************************
+
+FrameDiff::FrameDiff(int width, int height, int bitsPerPixel):
+    _width(width),
+    _height(height),
+    _bitsPerPixel(bitsPerPixel),
+    _stride((width * bitsPerPixel + 7) / 8),
+    _firstByte(height),
+    _lastByte(height)
+{
+    reset();
+}
+
+void FrameDiff::reset()
+{
+    _planes = 0;
+    _changedPixels = 0;
+    std::fill(_firstByte.begin(), _firstByte.end(), -1);
+    std::fill(_lastByte.begin(), _lastByte.end(), -1);
+}
+
+// ***************************************************************************
+
+/// Number of pixels differing in the xor'ed word d
+static inline uint32_t countChanged(uint32_t d, int bitsPerPixel)
+{
+    if (bitsPerPixel == 2)
+    {
+        d = (d | (d >> 1)) & 0x55555555;
+    }
+    return __builtin_popcount(d);
+}
+
+void FrameDiff::compare(const uint8_t *current, const uint8_t *previous)
+{
+    // ignore the padding bits at the end of each row
+    const int usedBits = (_width * _bitsPerPixel) % 8;
+    const uint8_t lastByteMask = usedBits ? (uint8_t)(0xff << (8 - usedBits)) : 0xff;
+    const int words = (_stride - 1) / 4;
+
+    for (int y = 0; y < _height; y++)
+    {
+        const uint8_t *a = current + y * _stride;
+        const uint8_t *b = previous + y * _stride;
+        int first = -1;
+        int last = -1;
+
+        for (int i = 0; i < 4 * words; i += 4)
+        {
+            uint32_t wa, wb;
+            memcpy(&wa, a + i, sizeof(wa));
+            memcpy(&wb, b + i, sizeof(wb));
+            const uint32_t d = wa ^ wb;
+            if (d == 0)
+                continue;
+
+            _changedPixels += countChanged(d, _bitsPerPixel);
+            for (int k = 0; first < 0 && k < 4; k++)
+            {
+                if (a[i + k] != b[i + k])
+                    first = i + k;
+            }
+            for (int k = 3; k >= 0; k--)
+            {
+                if (a[i + k] != b[i + k])
+                {
+                    last = i + k;
+                    break;
+                }
+            }
+        }
+        for (int i = 4 * words; i < _stride; i++)
+        {
+            uint8_t d = a[i] ^ b[i];
+            if (i == _stride - 1)
+                d &= lastByteMask;
+            if (d == 0)
+                continue;
+            _changedPixels += countChanged(d, _bitsPerPixel);
+            if (first < 0)
+                first = i;
+            last = i;
+        }
+
+        if (first >= 0)
+        {
+            if (_firstByte[y] < 0 || first < _firstByte[y])
+                _firstByte[y] = first;
+            if (last > _lastByte[y])
+                _lastByte[y] = last;
+        }
+    }
+    _planes++;
+}
+
+float FrameDiff::getChangedRatio() const
+{
+    if (_planes == 0)
+        return 0.0;
+    return (float) _changedPixels / ((float) _width * _height * _planes);
+}
+
+// ***************************************************************************
+
+static DiffRect unite(const DiffRect& a, const DiffRect& b)
+{
+    const int x0 = a.x < b.x ? a.x : b.x;
+    const int y0 = a.y < b.y ? a.y : b.y;
+    const int x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    const int y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+    return DiffRect{ (int16_t) x0, (int16_t) y0, (int16_t)(x1 - x0), (int16_t)(y1 - y0) };
+}
+
+std::vector<DiffRect> FrameDiff::getRects() const
+{
+    std::vector<DiffRect> rects;
+    const int pixelsPerByte = 8 / _bitsPerPixel;
+    const int alignedWidth = (_width + 7) & ~7;
+
+    // grow a rectangle while consecutive rows have overlapping spans
+    bool open = false;
+    DiffRect cur = { 0, 0, 0, 0 };
+    for (int y = 0; y < _height; y++)
+    {
+        if (_firstByte[y] < 0)
+        {
+            if (open)
+                rects.push_back(cur);
+            open = false;
+            continue;
+        }
+
+        int x0 = (_firstByte[y] * pixelsPerByte) & ~7;
+        int x1 = ((_lastByte[y] + 1) * pixelsPerByte + 7) & ~7;
+        if (x1 > alignedWidth)
+            x1 = alignedWidth;
+
+        if (open && x0 <= cur.x + cur.w && x1 >= cur.x)
+        {
+            cur = unite(cur, DiffRect{ (int16_t) x0, (int16_t) y, (int16_t)(x1 - x0), 1 });
+        } else {
+            if (open)
+                rects.push_back(cur);
+            cur = DiffRect{ (int16_t) x0, (int16_t) y, (int16_t)(x1 - x0), 1 };
+            open = true;
+        }
+    }
+    if (open)
+        rects.push_back(cur);
+
+    // merge the pair wasting the least area while there are too many
+    // rectangles or a merge does not cost any additional area
+    while (rects.size() > 1)
+    {
+        size_t bestI = 0, bestJ = 1;
+        int32_t bestWaste = INT32_MAX;
+        for (size_t i = 0; i < rects.size(); i++)
+        {
+            for (size_t j = i + 1; j < rects.size(); j++)
+            {
+                int32_t waste = unite(rects[i], rects[j]).getArea() - rects[i].getArea() - rects[j].getArea();
+                if (waste < bestWaste)
+                {
+                    bestWaste = waste;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        if (rects.size() <= MAX_RECTS && bestWaste > 0)
+            break;
+        rects[bestI] = unite(rects[bestI], rects[bestJ]);
+        rects.erase(rects.begin() + bestJ);
+    }
+    return rects;
+}
+
+// ***************************************************************************
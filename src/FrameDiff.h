@@ -0,0 +1,64 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// ***************************************************************************
+
+/**
+ * Rectangle in panel pixels. x and w are multiples of the controller's
+ * window granularity of 8 pixels.
+ */
+struct DiffRect
+{
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+
+    int32_t getArea() const { return (int32_t) w * h; }
+};
+
+// ***************************************************************************
+
+/**
+ * Compares the planes of a new frame against the previously displayed ones
+ * 32 bits at a time. Collects the changed column span of every row, merges
+ * the rows into a small set of 8 pixel aligned rectangles and counts the
+ * changed pixels. Call compare() once per plane (channel); the results
+ * accumulate until reset().
+ */
+class FrameDiff
+{
+public:
+    static const int MAX_RECTS = 8;
+
+    FrameDiff(int width, int height, int bitsPerPixel);
+
+    void reset();
+    void compare(const uint8_t *current, const uint8_t *previous);
+
+    bool hasChanges() const { return _changedPixels > 0; }
+    uint32_t getChangedPixels() const { return _changedPixels; }
+    /// changed pixels relative to the pixels of all compared planes
+    float getChangedRatio() const;
+    /// changed regions, at most MAX_RECTS
+    std::vector<DiffRect> getRects() const;
+
+private:
+    const int _width;
+    const int _height;
+    const int _bitsPerPixel;
+    const int _stride;
+    int _planes;
+    uint32_t _changedPixels;
+    std::vector<int16_t> _firstByte;  //< first changed byte per row, -1 if unchanged
+    std::vector<int16_t> _lastByte;   //< last changed byte per row
+};
+
+// ***************************************************************************
@@ -0,0 +1,194 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <string.h>
+#include <vector>
+
+#include "BitOps.h"
+#include "FrameRotation.h"
+
+// ***************************************************************************
+
+static inline int strideOf(int width, int bitsPerPixel)
+{
+    return (width * bitsPerPixel + 7) / 8;
+}
+
+/**
+ * Returns the 8 pixels of a 1 bpp row starting at pixel start. Pixels
+ * outside the row, including the padding bits, read as 0.
+ */
+static inline uint8_t extract8(const uint8_t *row, int width, int start)
+{
+    if (start >= width || start <= -8)
+        return 0;
+
+    const int stride = strideOf(width, 1);
+    const int idx = start >> 3;     // floor, also for negative start
+    const uint16_t hi = (idx >= 0) ? row[idx] : 0;
+    const uint16_t lo = (idx + 1 < stride) ? row[idx + 1] : 0;
+    uint8_t v = (uint8_t)((((hi << 8) | lo) << (start & 7)) >> 8);
+    if (start + 8 > width)
+        v &= 0xff << (start + 8 - width);
+    return v;
+}
+
+static inline int getPixel(const uint8_t *buf, int stride, int bitsPerPixel, int x, int y)
+{
+    const int bitPos = x * bitsPerPixel;
+    const int shift = 8 - bitsPerPixel - (bitPos & 7);
+    return (buf[y * stride + bitPos / 8] >> shift) & ((1 << bitsPerPixel) - 1);
+}
+
+static inline void setPixel(uint8_t *buf, int stride, int bitsPerPixel, int x, int y, int value)
+{
+    const int bitPos = x * bitsPerPixel;
+    const int shift = 8 - bitsPerPixel - (bitPos & 7);
+    const uint8_t mask = ((1 << bitsPerPixel) - 1) << shift;
+    uint8_t *ptr = &buf[y * stride + bitPos / 8];
+    *ptr = (*ptr & ~mask) | ((value << shift) & mask);
+}
+
+// ***************************************************************************
+
+void FrameRotation::getNativeSize(int rotation, int width, int height, int& nativeWidth, int& nativeHeight)
+{
+    if (rotation & 1)
+    {
+        nativeWidth = height;
+        nativeHeight = width;
+    } else {
+        nativeWidth = width;
+        nativeHeight = height;
+    }
+}
+
+// ***************************************************************************
+
+/// Slow path: maps every native pixel back to its logical position
+static void rotateBandPixels(const uint8_t *src, int width, int height, int bitsPerPixel,
+    int rotation, int firstRow, int numRows, uint8_t *dst)
+{
+    int nw, nh;
+    FrameRotation::getNativeSize(rotation, width, height, nw, nh);
+    const int srcStride = strideOf(width, bitsPerPixel);
+    const int dstStride = strideOf(nw, bitsPerPixel);
+
+    for (int py = firstRow; py < firstRow + numRows && py < nh; py++)
+    {
+        for (int px = 0; px < nw; px++)
+        {
+            int lx, ly;
+            switch (rotation & 3) {
+            case 1: lx = py; ly = nw - 1 - px; break;
+            case 2: lx = nw - 1 - px; ly = nh - 1 - py; break;
+            case 3: lx = nh - 1 - py; ly = px; break;
+            default: lx = px; ly = py; break;
+            }
+            setPixel(dst, dstStride, bitsPerPixel, px, py - firstRow,
+                getPixel(src, srcStride, bitsPerPixel, lx, ly));
+        }
+    }
+}
+
+void FrameRotation::rotateBand(const uint8_t *src, int width, int height, int bitsPerPixel,
+    int rotation, int firstRow, int numRows, uint8_t *dst)
+{
+    rotation &= 3;
+    if (bitsPerPixel != 1)
+    {
+        rotateBandPixels(src, width, height, bitsPerPixel, rotation, firstRow, numRows, dst);
+        return;
+    }
+
+    int nw, nh;
+    getNativeSize(rotation, width, height, nw, nh);
+    const int srcStride = strideOf(width, 1);
+    const int dstStride = strideOf(nw, 1);
+    const int lastRow = (firstRow + numRows < nh) ? firstRow + numRows : nh;
+
+    if (rotation == 0)
+    {
+        memcpy(dst, src + firstRow * srcStride, (lastRow - firstRow) * srcStride);
+        return;
+    }
+
+    if (rotation == 2)
+    {
+        // native row py is the mirrored logical row nh-1-py
+        for (int py = firstRow; py < lastRow; py++)
+        {
+            const uint8_t *row = src + (nh - 1 - py) * srcStride;
+            uint8_t *out = dst + (py - firstRow) * dstStride;
+            for (int bx = 0; bx < dstStride; bx++)
+            {
+                out[bx] = BitOps::reverseBits(extract8(row, width, nw - 8 - 8 * bx));
+            }
+        }
+        return;
+    }
+
+    // 90/270 degrees: each native 8x8 block is the transpose of 8 logical
+    // rows (one per native column) at the byte column of the block's rows
+    for (int py0 = firstRow & ~7; py0 < lastRow; py0 += 8)
+    {
+        for (int bx = 0; bx < dstStride; bx++)
+        {
+            uint64_t block = 0;
+            for (int c = 0; c < 8; c++)
+            {
+                const int px = 8 * bx + c;
+                uint8_t bits = 0;
+                if (px < nw)
+                {
+                    if (rotation == 1)
+                        bits = extract8(src + (nw - 1 - px) * srcStride, width, py0);
+                    else
+                        bits = BitOps::reverseBits(extract8(src + px * srcStride, width, nh - 8 - py0));
+                }
+                block = (block << 8) | bits;
+            }
+            block = BitOps::transpose8x8(block);
+
+            for (int r = 0; r < 8; r++)
+            {
+                const int py = py0 + r;
+                if (py >= firstRow && py < lastRow)
+                    dst[(py - firstRow) * dstStride + bx] = (uint8_t)(block >> (56 - 8 * r));
+            }
+        }
+    }
+}
+
+void FrameRotation::rotateFrame(const uint8_t *src, int width, int height, int bitsPerPixel,
+    int rotation, uint8_t *dst)
+{
+    int nw, nh;
+    getNativeSize(rotation, width, height, nw, nh);
+    const int dstStride = strideOf(nw, bitsPerPixel);
+    for (int py = 0; py < nh; py += 8)
+    {
+        rotateBand(src, width, height, bitsPerPixel, rotation, py, 8, dst + py * dstStride);
+    }
+}
+
+void FrameRotation::rotate180InPlace(uint8_t *buf, int width, int height, int bitsPerPixel)
+{
+    const int stride = strideOf(width, bitsPerPixel);
+    std::vector<uint8_t> top(stride), bottom(stride);
+
+    // swap and mirror pairs of rows, the middle row is mirrored with itself
+    for (int y = 0; y < (height + 1) / 2; y++)
+    {
+        uint8_t *rowTop = buf + y * stride;
+        uint8_t *rowBottom = buf + (height - 1 - y) * stride;
+        memcpy(top.data(), rowTop, stride);
+        memcpy(bottom.data(), rowBottom, stride);
+        rotateBand(top.data(), width, 1, bitsPerPixel, 2, 0, 1, rowBottom);
+        rotateBand(bottom.data(), width, 1, bitsPerPixel, 2, 0, 1, rowTop);
+    }
+}
+
+// ***************************************************************************
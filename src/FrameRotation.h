@@ -0,0 +1,44 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// ***************************************************************************
+
+/**
+ * Whole-frame rotation of packed pixel data. The rotation is given in
+ * quarter turns as for Adafruit_GFX::setRotation(): a frame drawn in the
+ * rotated (logical) orientation ends up where the per-pixel rotation in
+ * PixelBuffer::drawPixel() would have put it in the panel (native)
+ * orientation.
+ *
+ * 1 bpp frames are rotated in 8x8 bit blocks using bit-matrix transposes,
+ * 2 bpp frames fall back to copying single pixels.
+ */
+class FrameRotation
+{
+public:
+    /// Size of the native frame for a logical frame of width x height
+    static void getNativeSize(int rotation, int width, int height, int& nativeWidth, int& nativeHeight);
+
+    /**
+     * Computes the native rows [firstRow, firstRow + numRows) of the logical
+     * frame src (width x height) into the band buffer dst, which uses the
+     * native stride. Bands starting at multiples of 8 rows are fastest.
+     */
+    static void rotateBand(const uint8_t *src, int width, int height, int bitsPerPixel,
+        int rotation, int firstRow, int numRows, uint8_t *dst);
+
+    /// Rotates the complete logical frame src into dst, 8 rows at a time
+    static void rotateFrame(const uint8_t *src, int width, int height, int bitsPerPixel,
+        int rotation, uint8_t *dst);
+
+    /// Rotates a frame by 180 degrees in place
+    static void rotate180InPlace(uint8_t *buf, int width, int height, int bitsPerPixel);
+};
+
+// ***************************************************************************
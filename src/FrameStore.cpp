@@ -0,0 +1,147 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+
+#include "FrameStore.h"
+
+// ***************************************************************************
+
+static const uint32_t FRAME_STORE_MAGIC = 0x31465045;  // "EPF1"
+
+FrameStore::FrameStore(const char *path, const Logger& parentLogger):
+    _path(path),
+    _isMounted(false),
+    _logger(__FILE__, parentLogger)
+{
+}
+
+bool FrameStore::begin()
+{
+    if (!_isMounted)
+    {
+        // formats the partition on first use
+        _isMounted = SPIFFS.begin(/*formatOnFail*/ true);
+        if (!_isMounted)
+        {
+            _logger.error("Cannot mount SPIFFS");
+        }
+    }
+    return _isMounted;
+}
+
+// ***************************************************************************
+
+bool FrameStore::readHeader(File& file, Header& header)
+{
+    if (file.read((uint8_t *) &header, sizeof(header)) != sizeof(header) || header.magic != FRAME_STORE_MAGIC)
+    {
+        return false;
+    }
+    header.version[MAX_VERSION_SIZE - 1] = 0;
+    return true;
+}
+
+String FrameStore::getVersion()
+{
+    if (!begin() || !SPIFFS.exists(_path))
+        return "";
+
+    File file = SPIFFS.open(_path, FILE_READ);
+    Header header;
+    bool isOk = file && readHeader(file, header);
+    file.close();
+    return isOk ? String(header.version) : String("");
+}
+
+bool FrameStore::save(const PixelBuffer& pb, const String& version)
+{
+    if (!begin() || pb.getBufPtr() == nullptr)
+        return false;
+
+    Header header = {};
+    header.magic = FRAME_STORE_MAGIC;
+    header.width = pb.width();
+    header.height = pb.height();
+    header.bitsPerPixel = pb.getBitsPerPixel();
+    header.planes = pb.getPlanes();
+    header.frameRotation = pb.getFrameRotation();
+    header.planeSize = pb.getPlaneSize();
+    strncpy(header.version, version.c_str(), MAX_VERSION_SIZE - 1);
+
+    unsigned long start_ms = millis();
+    File file = SPIFFS.open(_path, FILE_WRITE);
+    if (!file)
+    {
+        _logger.error("Cannot open %s for writing", _path);
+        return false;
+    }
+    bool isOk = file.write((const uint8_t *) &header, sizeof(header)) == sizeof(header)
+        && file.write(pb.getBufPtr(), pb.getBufSize()) == pb.getBufSize();
+    file.close();
+    if (!isOk)
+    {
+        _logger.error("Cannot write %s", _path);
+        remove();
+        return false;
+    }
+    _logger.info("Stored frame version %s (%d B) in %lu ms", header.version, pb.getBufSize(), millis() - start_ms);
+    return true;
+}
+
+bool FrameStore::load(PixelBuffer& pb, const String& version)
+{
+    if (!begin() || !SPIFFS.exists(_path))
+        return false;
+
+    File file = SPIFFS.open(_path, FILE_READ);
+    if (!file)
+    {
+        _logger.error("Cannot open %s for reading", _path);
+        return false;
+    }
+
+    Header header;
+    if (!readHeader(file, header) || version != header.version)
+    {
+        _logger.info("No stored frame for version %s", version.c_str());
+        file.close();
+        return false;
+    }
+    if (pb.getBufPtr() == nullptr && !pb.allocateBuf())
+    {
+        file.close();
+        return false;
+    }
+    if (header.width != pb.width() || header.height != pb.height()
+        || header.bitsPerPixel != pb.getBitsPerPixel() || header.planes != pb.getPlanes()
+        || header.frameRotation != pb.getFrameRotation() || header.planeSize != pb.getPlaneSize())
+    {
+        _logger.error("Stored frame does not match the panel configuration");
+        file.close();
+        return false;
+    }
+
+    bool isOk = file.read(pb.getBufPtr(), pb.getBufSize()) == pb.getBufSize();
+    file.close();
+    if (!isOk)
+    {
+        _logger.error("Cannot read %s", _path);
+        return false;
+    }
+    _logger.info("Restored frame version %s", header.version);
+    return true;
+}
+
+void FrameStore::remove()
+{
+    if (begin() && SPIFFS.exists(_path))
+    {
+        SPIFFS.remove(_path);
+    }
+}
+
+// ***************************************************************************
@@ -0,0 +1,59 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "logger.h"
+#include "PixelBuffer.h"
+
+// ***************************************************************************
+
+/**
+ * Keeps the planes of a frame together with a version string (e.g. the
+ * HTTP ETag) in a SPIFFS file, so it survives deep sleep and power loss.
+ * Frames are stored in the layout they are drawn in, i.e. before
+ * PixelBuffer::rotateToPanel().
+ */
+class FrameStore
+{
+public:
+    static const int MAX_VERSION_SIZE = 64;
+
+    FrameStore(const char *path, const Logger& parentLogger = rootLogger);
+
+    bool begin();
+
+    /// Version of the stored frame, empty if there is none
+    String getVersion();
+    bool save(const PixelBuffer& pb, const String& version);
+    /// Allocates the planes of pb and reads the frame if the stored version matches
+    bool load(PixelBuffer& pb, const String& version);
+    void remove();
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t width;
+        uint16_t height;
+        uint8_t bitsPerPixel;
+        uint8_t planes;
+        uint8_t frameRotation;
+        uint8_t reserved;
+        uint32_t planeSize;
+        char version[MAX_VERSION_SIZE];
+    };
+
+    bool readHeader(File& file, Header& header);
+
+    const char *_path;
+    bool _isMounted;
+    Logger _logger;
+};
+
+// ***************************************************************************
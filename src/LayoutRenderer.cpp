@@ -0,0 +1,268 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Adafruit_GFX.h>
+#include <Fonts/FreeSans9pt7b.h>
+#include <Fonts/FreeSans12pt7b.h>
+#include <Fonts/FreeSansBold12pt7b.h>
+#include <Fonts/FreeSansBold18pt7b.h>
+#include <Fonts/FreeSansBold24pt7b.h>
+
+#include "Sprite.h"
+#include "LayoutRenderer.h"
+
+// ***************************************************************************
+
+static const GFXfont* const fonts[LayoutRenderer::FONT_COUNT] = {
+    nullptr,                // built-in 6x8
+    &FreeSans9pt7b,
+    &FreeSans12pt7b,
+    &FreeSansBold12pt7b,
+    &FreeSansBold18pt7b,
+    &FreeSansBold24pt7b,
+};
+
+const GFXfont* LayoutRenderer::getFont(int fontId)
+{
+    if (fontId < 0 || fontId >= FONT_COUNT)
+        return nullptr;
+    return fonts[fontId];
+}
+
+LayoutRenderer::RgbColor LayoutRenderer::parseColor(const char *color)
+{
+    if (color == nullptr)
+        return std::make_tuple(0, 0, 0);
+    if (color[0] == '#' && strlen(color) == 7)
+    {
+        uint32_t rgb = strtoul(color + 1, nullptr, 16);
+        return std::make_tuple((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff);
+    }
+    if (strcmp(color, "white") == 0)
+        return std::make_tuple(255, 255, 255);
+    if (strcmp(color, "red") == 0)
+        return std::make_tuple(255, 0, 0);
+    if (strcmp(color, "yellow") == 0)
+        return std::make_tuple(255, 255, 0);
+    if (strcmp(color, "grey") == 0)
+        return std::make_tuple(128, 128, 128);
+    return std::make_tuple(0, 0, 0);
+}
+
+// ***************************************************************************
+
+LayoutRenderer::LayoutRenderer(PixelBuffer& pb, const Logger& parentLogger):
+    _pb(pb),
+    _logger(__FILE__, parentLogger)
+{
+}
+
+/**
+ * Parses the layout and draws all elements into all planes.
+ */
+bool LayoutRenderer::render(const char *json, size_t length)
+{
+    if (_pb.getBufPtr() == nullptr)
+    {
+        _logger.error("_bufPtr not set. Call PixelBuffer::allocateBuf first.");
+        return false;
+    }
+
+    // strings are copied from the read-only input
+    DynamicJsonDocument doc(2 * length + 1024);
+    DeserializationError error = deserializeJson(doc, json, length);
+    if (error)
+    {
+        _logger.error("Cannot parse layout: %s", error.c_str());
+        return false;
+    }
+
+    JsonArrayConst elements = doc["elements"].as<JsonArrayConst>();
+    _logger.info("Rendering %d layout element(s) into %d plane(s)", elements.size(), _pb.getPlanes());
+
+    for (int plane = 0; plane < _pb.getPlanes(); plane++)
+    {
+        _pb.selectPlane(plane);
+        if (doc.containsKey("background"))
+        {
+            _pb.fillScreen(getColor(doc["background"].as<JsonVariantConst>(), plane, "white"));
+        }
+        for (JsonObjectConst element : elements)
+        {
+            renderElement(element, plane);
+        }
+    }
+    _pb.selectPlane(0);
+    _pb.setFont(nullptr);
+    return true;
+}
+
+// ***************************************************************************
+
+uint16_t LayoutRenderer::getColor(JsonVariantConst color, int plane, const char *defaultColor)
+{
+    RgbColor rgb = parseColor(color | defaultColor);
+    return _pb.getPlaneValue(plane, std::get<0>(rgb), std::get<1>(rgb), std::get<2>(rgb));
+}
+
+void LayoutRenderer::renderElement(JsonObjectConst element, int plane)
+{
+    const char *type = element["type"] | "";
+    const uint16_t color = getColor(element["color"], plane);
+
+    if (strcmp(type, "text") == 0)
+    {
+        drawText(element, element["text"] | "", color);
+    }
+    else if (strcmp(type, "number") == 0)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f%s",
+            element["decimals"] | 0, element["value"] | 0.0f, element["unit"] | "");
+        drawText(element, text, color);
+    }
+    else if (strcmp(type, "line") == 0)
+    {
+        _pb.drawLine(element["x0"] | 0, element["y0"] | 0, element["x1"] | 0, element["y1"] | 0, color);
+    }
+    else if (strcmp(type, "rect") == 0)
+    {
+        if (element["fill"] | false)
+            _pb.fillRect(element["x"] | 0, element["y"] | 0, element["w"] | 0, element["h"] | 0, color);
+        else
+            _pb.drawRect(element["x"] | 0, element["y"] | 0, element["w"] | 0, element["h"] | 0, color);
+    }
+    else if (strcmp(type, "icon") == 0)
+    {
+        // sprites paint their background in the inverse color, which is only
+        // white in planes where the icon color differs from white
+        if (color != getColor(JsonVariantConst(), plane, "white"))
+            drawIcon(element, color);
+    }
+    else if (strcmp(type, "bar") == 0)
+    {
+        drawBar(element, color);
+    }
+    else if (strcmp(type, "chart") == 0)
+    {
+        drawChart(element, color);
+    }
+    else if (plane == 0)
+    {
+        _logger.error("Unknown layout element type \"%s\"", type);
+    }
+}
+
+void LayoutRenderer::drawText(JsonObjectConst element, const char *text, uint16_t color)
+{
+    const int x = element["x"] | 0;
+    const int y = element["y"] | 0;
+    const char *align = element["align"] | "left";
+
+    _pb.setFont(getFont(element["font"] | 0));
+    _pb.setTextSize(element["size"] | 1);
+    if (strcmp(align, "center") == 0)
+        _pb.drawText(x, y, color, text, PixelBuffer::ALIGN_CENTER);
+    else if (strcmp(align, "right") == 0)
+        _pb.drawText(x, y, color, text, PixelBuffer::ALIGN_RIGHT);
+    else
+        _pb.drawText(x, y, color, text);
+}
+
+void LayoutRenderer::drawIcon(JsonObjectConst element, uint16_t color)
+{
+    const int x = element["x"] | 0;
+    const int y = element["y"] | 0;
+    const char *icon = element["icon"] | "";
+    const int value = element["value"] | 0;
+
+    if (strcmp(icon, "battery") == 0)
+        _pb.drawSprite(x, y, StatusIcons::battery(value), color);
+    else if (strcmp(icon, "wifi") == 0)
+        _pb.drawSprite(x, y, StatusIcons::wifi(value), color);
+    else if (strcmp(icon, "stale") == 0)
+        _pb.drawStale(x, y, color);
+    else if (strcmp(icon, "error") == 0)
+        _pb.drawError(x, y, color, value);
+    else
+        _logger.error("Unknown icon \"%s\"", icon);
+}
+
+void LayoutRenderer::drawBar(JsonObjectConst element, uint16_t color)
+{
+    const int x = element["x"] | 0;
+    const int y = element["y"] | 0;
+    const int w = element["w"] | 0;
+    const int h = element["h"] | 0;
+    const float min = element["min"] | 0.0f;
+    const float max = element["max"] | 100.0f;
+    float value = element["value"] | 0.0f;
+
+    if (value < min)
+        value = min;
+    if (value > max)
+        value = max;
+    _pb.drawRect(x, y, w, h, color);
+    if (max > min && w > 4 && h > 4)
+    {
+        _pb.fillRect(x + 2, y + 2, (int)((w - 4) * (value - min) / (max - min)), h - 4, color);
+    }
+}
+
+/**
+ * Polyline over the values, scaled to the given range or to the range of
+ * the values if min/max are not given.
+ */
+void LayoutRenderer::drawChart(JsonObjectConst element, uint16_t color)
+{
+    const int x = element["x"] | 0;
+    const int y = element["y"] | 0;
+    const int w = element["w"] | 0;
+    const int h = element["h"] | 0;
+    JsonArrayConst values = element["values"].as<JsonArrayConst>();
+    const size_t count = values.size();
+    if (count < 2 || w < 2 || h < 2)
+        return;
+
+    float min = values[0] | 0.0f;
+    float max = min;
+    for (JsonVariantConst v : values)
+    {
+        const float f = v | 0.0f;
+        if (f < min)
+            min = f;
+        if (f > max)
+            max = f;
+    }
+    min = element["min"] | min;
+    max = element["max"] | max;
+    if (max <= min)
+        max = min + 1.0f;
+
+    if (element["frame"] | false)
+        _pb.drawRect(x, y, w, h, color);
+
+    int16_t prevX = 0, prevY = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        float f = values[i] | 0.0f;
+        if (f < min)
+            f = min;
+        if (f > max)
+            f = max;
+        const int16_t px = x + (int)((w - 1) * i / (count - 1));
+        const int16_t py = y + h - 1 - (int)((h - 1) * (f - min) / (max - min));
+        if (i > 0)
+            _pb.drawLine(prevX, prevY, px, py, color);
+        prevX = px;
+        prevY = py;
+    }
+}
+
+// ***************************************************************************
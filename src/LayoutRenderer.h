@@ -0,0 +1,64 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <tuple>
+
+#include <ArduinoJson.h>
+
+#include "logger.h"
+#include "PixelBuffer.h"
+
+// ***************************************************************************
+
+/**
+ * Renders a compact JSON layout description directly into the planes of a
+ * PixelBuffer, replacing a server rendered PNG:
+ *
+ *   { "background": "white",
+ *     "elements": [
+ *       { "type": "text", "x": 10, "y": 10, "text": "Kitchen", "font": 2, "align": "left" },
+ *       { "type": "number", "x": 10, "y": 40, "value": 21.5, "decimals": 1, "unit": " C", "font": 4 },
+ *       { "type": "line", "x0": 0, "y0": 80, "x1": 399, "y1": 80 },
+ *       { "type": "rect", "x": 0, "y": 90, "w": 50, "h": 20, "fill": true, "color": "red" },
+ *       { "type": "icon", "x": 300, "y": 5, "icon": "battery", "value": 80 },
+ *       { "type": "bar", "x": 10, "y": 120, "w": 100, "h": 10, "value": 30, "min": 0, "max": 100 },
+ *       { "type": "chart", "x": 10, "y": 140, "w": 200, "h": 60, "values": [1, 3, 2] } ] }
+ *
+ * Coordinates are logical pixels, text is positioned by the top edge of its
+ * bounding box. Colors are "#rrggbb" or one of black, white, red, yellow,
+ * grey, the default is black. Without "background" the buffer is left as
+ * is, so a layout can also be drawn on top of an image.
+ */
+class LayoutRenderer
+{
+public:
+    typedef std::tuple<uint8_t, uint8_t, uint8_t> RgbColor;
+
+    static const int FONT_COUNT = 6;
+
+    LayoutRenderer(PixelBuffer& pb, const Logger& parentLogger = rootLogger);
+
+    bool render(const char *json, size_t length);
+
+    /// Adafruit GFX font for a font id, nullptr for the built-in 6x8 font
+    static const GFXfont* getFont(int fontId);
+    static RgbColor parseColor(const char *color);
+
+private:
+    void renderElement(JsonObjectConst element, int plane);
+    void drawText(JsonObjectConst element, const char *text, uint16_t color);
+    void drawIcon(JsonObjectConst element, uint16_t color);
+    void drawBar(JsonObjectConst element, uint16_t color);
+    void drawChart(JsonObjectConst element, uint16_t color);
+    uint16_t getColor(JsonVariantConst color, int plane, const char *defaultColor = "black");
+
+    PixelBuffer& _pb;
+    Logger _logger;
+};
+
+// ***************************************************************************
@@ -0,0 +1,197 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <esp_heap_caps.h>
+
+#include "DisplayList.h"
+#include "MemoryPlanner.h"
+
+// ***************************************************************************
+
+// pngle: inflate state (~11 KB) and LZ dictionary (32 KB) plus two scanlines
+static const size_t DECODER_STATE_SIZE = 44 * 1024;
+static const size_t LAYOUT_DOCUMENT_SIZE = 8 * 1024;
+static const size_t MIN_RESPONSE_SIZE = 16 * 1024;
+
+static const char *bufferNames[MemoryPlanner::BUFFER_COUNT] = {
+    "frame", "rotation", "decoder", "response", "layout", "band", "transfer", "panel"
+};
+static const char *regionNames[MemoryPlanner::REGION_COUNT] = {
+    "internal", "psram", "arena"
+};
+
+static uint8_t arena[MemoryPlanner::ARENA_SIZE] __attribute__((aligned(4)));
+static uint8_t *arenaLast = nullptr;
+
+size_t MemoryPlanner::_sizes[BUFFER_COUNT] = {};
+MemoryPlanner::Region MemoryPlanner::_regions[BUFFER_COUNT] = {};
+size_t MemoryPlanner::_arenaUsed = 0;
+bool MemoryPlanner::_isStreaming = false;
+
+// ***************************************************************************
+
+bool MemoryPlanner::plan(const Panel& panel, int frameRotation, const Logger& logger)
+{
+    const int width = panel.getWidth();
+    const int height = panel.getHeight();
+    const int bpp = panel.getBitsPerChannel();
+
+    // same layout as PixelBuffer: the larger of the panel and the logical layout
+    size_t planeSize = height * ((width * bpp + 7) / 8);
+    if (frameRotation & 1)
+    {
+        const size_t logicalSize = width * ((height * bpp + 7) / 8);
+        if (logicalSize > planeSize)
+            planeSize = logicalSize;
+    }
+
+    _sizes[FRAME] = planeSize * panel.getChannels();
+    _sizes[ROTATION] = (frameRotation & 1) ? planeSize : 0;
+    _sizes[DECODER] = DECODER_STATE_SIZE + 2 * 4 * width;
+    // dashboards compress well, budget half of the raw frame for the PNG
+    _sizes[RESPONSE] = _sizes[FRAME] / 2 > MIN_RESPONSE_SIZE ? _sizes[FRAME] / 2 : MIN_RESPONSE_SIZE;
+    _sizes[LAYOUT] = LAYOUT_DOCUMENT_SIZE;
+    _sizes[BAND] = DisplayList::DEFAULT_BAND_ROWS * ((width * bpp + 7) / 8);
+    _sizes[TRANSFER] = PanelInterface::TRANSFER_BUFFERS * PanelInterface::TRANSFER_BUFFER_SIZE;
+    _sizes[PANEL] = panel.getPlaneBufferSize();
+
+    const bool hasPsram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+    const Region bulk = hasPsram ? PSRAM : INTERNAL;
+    _regions[FRAME] = bulk;
+    _regions[ROTATION] = bulk;
+    _regions[RESPONSE] = bulk;
+    _regions[DECODER] = INTERNAL;
+    _regions[LAYOUT] = INTERNAL;
+    _regions[BAND] = _sizes[BAND] <= ARENA_SIZE ? ARENA : INTERNAL;
+    _regions[TRANSFER] = INTERNAL;
+    _regions[PANEL] = bulk;
+
+    _isStreaming = false;
+    if (check(logger, false))
+    {
+        report(logger);
+        return true;
+    }
+
+    // without a frame buffer, only the bands and the planes of the panel are kept in memory
+    if ((frameRotation & 3) == 0)
+    {
+        _sizes[FRAME] = 0;
+        _sizes[ROTATION] = 0;
+        _isStreaming = true;
+        logger.info("Frame of %d B does not fit, streaming images band by band", planeSize * panel.getChannels());
+        if (_sizes[PANEL] > 0)
+        {
+            logger.info("Panel %s still buffers %d B of channel planes", panel.getName(), _sizes[PANEL]);
+        }
+    }
+    report(logger);
+    return check(logger, true);
+}
+
+/// Checks the budget: all buffers of a region and its largest contiguous buffer
+bool MemoryPlanner::check(const Logger& logger, bool isReporting)
+{
+    size_t totals[REGION_COUNT] = {};
+    size_t largest[REGION_COUNT] = {};
+    for (int i = 0; i < BUFFER_COUNT; i++)
+    {
+        totals[_regions[i]] += _sizes[i];
+        if (_sizes[i] > largest[_regions[i]])
+            largest[_regions[i]] = _sizes[i];
+    }
+    const size_t freeSize[REGION_COUNT] = {
+        heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+        ARENA_SIZE - _arenaUsed
+    };
+    const size_t freeBlock[REGION_COUNT] = {
+        heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM),
+        ARENA_SIZE - _arenaUsed
+    };
+
+    bool isOk = true;
+    for (int r = 0; r < REGION_COUNT; r++)
+    {
+        if (totals[r] > freeSize[r] || largest[r] > freeBlock[r])
+        {
+            if (isReporting)
+            {
+                logger.error("Memory plan does not fit into %s memory: needs %d B (largest %d B), "
+                    "free %d B (largest block %d B)",
+                    regionNames[r], totals[r], largest[r], freeSize[r], freeBlock[r]);
+            }
+            isOk = false;
+        }
+    }
+    return isOk;
+}
+
+void MemoryPlanner::report(const Logger& logger)
+{
+    for (int i = 0; i < BUFFER_COUNT; i++)
+    {
+        logger.info("Memory plan: %-8s %7d B in %s", bufferNames[i], _sizes[i], regionNames[_regions[i]]);
+    }
+    logger.info("Memory free: internal %d B (largest %d B), psram %d B, arena %d B",
+        heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+        ARENA_SIZE - _arenaUsed);
+}
+
+// ***************************************************************************
+
+void* MemoryPlanner::allocateFrom(Region region, size_t size)
+{
+    switch (region) {
+    case PSRAM:
+        return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    case ARENA: {
+        const size_t aligned = (size + 3) & ~3;
+        if (_arenaUsed + aligned > ARENA_SIZE)
+            return nullptr;
+        arenaLast = arena + _arenaUsed;
+        _arenaUsed += aligned;
+        return arenaLast;
+    }
+    default:
+        return heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+}
+
+void* MemoryPlanner::allocate(Buffer buffer, size_t size)
+{
+    void *ptr = allocateFrom(_regions[buffer], size);
+    if (ptr == nullptr && _regions[buffer] != INTERNAL)
+    {
+        ptr = allocateFrom(INTERNAL, size);
+    }
+    if (ptr == nullptr && _regions[buffer] != PSRAM)
+    {
+        ptr = allocateFrom(PSRAM, size);
+    }
+    return ptr;
+}
+
+void MemoryPlanner::release(Buffer buffer, void *ptr)
+{
+    if (ptr == nullptr)
+        return;
+    if ((uint8_t *) ptr >= arena && (uint8_t *) ptr < arena + ARENA_SIZE)
+    {
+        // the arena is a stack, only the last allocation can be returned
+        if (ptr == arenaLast)
+        {
+            _arenaUsed = arenaLast - arena;
+            arenaLast = nullptr;
+        }
+        return;
+    }
+    heap_caps_free(ptr);
+}
+
+// ***************************************************************************
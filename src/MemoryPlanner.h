@@ -0,0 +1,68 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "logger.h"
+#include "Panel.h"
+
+// ***************************************************************************
+
+/**
+ * Plans the memory of the update pipeline once per boot from the panel
+ * parameters and places each buffer by its access pattern:
+ *
+ * - FRAME, ROTATION: large, accessed row by row -> PSRAM if present
+ * - DECODER, LAYOUT: random access (inflate dictionary, JSON tree)
+ *   -> internal RAM; allocated by the libraries, only budgeted here
+ * - RESPONSE: the HTTP body, allocated by the HTTP client -> budgeted
+ *   in PSRAM if present
+ * - BAND: small and hot (band rendering, row conversion) -> static arena
+ * - TRANSFER: the SPI transfer buffers of PanelInterface -> internal RAM,
+ *   which is DMA capable
+ * - PANEL: channel planes the panel driver keeps to merge the channels,
+ *   see Panel::getPlaneBufferSize() -> PSRAM if present
+ *
+ * plan() checks the budget against the free heap regions and reports all
+ * buffers, so a configuration that cannot work fails before the download
+ * instead of in the middle of an update. If the frame does not fit, PNG
+ * images are streamed band by band without a frame (see isStreaming()).
+ * Panels buffering channel planes themselves need them while streaming,
+ * the plan fails if they do not fit either.
+ */
+class MemoryPlanner
+{
+public:
+    enum Buffer { FRAME, ROTATION, DECODER, RESPONSE, LAYOUT, BAND, TRANSFER, PANEL, BUFFER_COUNT };
+    enum Region { INTERNAL, PSRAM, ARENA, REGION_COUNT };
+
+    static const size_t ARENA_SIZE = 8 * 1024;
+
+    static bool plan(const Panel& panel, int frameRotation, const Logger& logger = rootLogger);
+    static void report(const Logger& logger = rootLogger);
+
+    static size_t getSize(Buffer buffer) { return _sizes[buffer]; }
+    static Region getRegion(Buffer buffer) { return _regions[buffer]; }
+    /// true if the plan has no frame buffer and images must be streamed
+    static bool isStreaming() { return _isStreaming; }
+
+    /// Allocates from the planned region, falls back to the heap regions
+    static void* allocate(Buffer buffer, size_t size);
+    static void release(Buffer buffer, void *ptr);
+
+private:
+    static void* allocateFrom(Region region, size_t size);
+    static bool check(const Logger& logger, bool isReporting);
+
+    static size_t _sizes[BUFFER_COUNT];
+    static Region _regions[BUFFER_COUNT];
+    static size_t _arenaUsed;
+    static bool _isStreaming;
+};
+
+// ***************************************************************************
@@ -3,151 +3,980 @@
  * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
  */
 
+#include <string.h>
+#include <GxEPD2.h>
+
+#include "BitOps.h"
+#include "MemoryPlanner.h"
 #include "Panel.h"
 
 // ***************************************************************************
 
-static const uint8_t EPD_4IN2_lut_vcom0[] = {
-    0x00, 0x17, 0x00, 0x00, 0x00, 0x02,
-    0x00, 0x17, 0x17, 0x00, 0x00, 0x02,
-    0x00, 0x0A, 0x01, 0x00, 0x00, 0x01,
-    0x00, 0x0E, 0x0E, 0x00, 0x00, 0x02,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00,
-};
-static const uint8_t EPD_4IN2_lut_ww[] = {
-    0x40, 0x17, 0x00, 0x00, 0x00, 0x02,
-    0x90, 0x17, 0x17, 0x00, 0x00, 0x02,
-    0x40, 0x0A, 0x01, 0x00, 0x00, 0x01,
-    0xA0, 0x0E, 0x0E, 0x00, 0x00, 0x02,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-};
-static const uint8_t EPD_4IN2_lut_bw[] = {
-    0x40, 0x17, 0x00, 0x00, 0x00, 0x02,
-    0x90, 0x17, 0x17, 0x00, 0x00, 0x02,
-    0x40, 0x0A, 0x01, 0x00, 0x00, 0x01,
-    0xA0, 0x0E, 0x0E, 0x00, 0x00, 0x02,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-};
-static const uint8_t EPD_4IN2_lut_wb[] = {
-    0x80, 0x17, 0x00, 0x00, 0x00, 0x02,
-    0x90, 0x17, 0x17, 0x00, 0x00, 0x02,
-    0x80, 0x0A, 0x01, 0x00, 0x00, 0x01,
-    0x50, 0x0E, 0x0E, 0x00, 0x00, 0x02,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-};
-static const uint8_t EPD_4IN2_lut_bb[] = {
-    0x80, 0x17, 0x00, 0x00, 0x00, 0x02,
-    0x90, 0x17, 0x17, 0x00, 0x00, 0x02,
-    0x80, 0x0A, 0x01, 0x00, 0x00, 0x01,
-    0x50, 0x0E, 0x0E, 0x00, 0x00, 0x02,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-};
-
-
-const Panel::RgbColors Panel43bw::_rgbColors = { std::make_tuple(255,255,255) };
+// Panel scripts, see PanelInterface::runScript()
+#define U16(v) (uint8_t) ((v) & 0xff), (uint8_t) ((v) >> 8)
+#define U32(v) U16((v) & 0xffff), U16((v) >> 16)
+#define BE16(v) (uint8_t) ((v) >> 8), (uint8_t) ((v) & 0xff)
+
+static const int WIDTH_4IN2 = 400;
+static const int HEIGHT_4IN2 = 300;
+
+// full waveform of the 4.2" panel, LUTs set by register
+#define EPD_4IN2_FULL_LUTS \
+    PanelInterface::SCRIPT_CMD, 0x20, 44,   \
+        0x00, 0x17, 0x00, 0x00, 0x00, 0x02, \
+        0x00, 0x17, 0x17, 0x00, 0x00, 0x02, \
+        0x00, 0x0A, 0x01, 0x00, 0x00, 0x01, \
+        0x00, 0x0E, 0x0E, 0x00, 0x00, 0x02, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00,                         \
+    PanelInterface::SCRIPT_CMD, 0x21, 42,   \
+        0x40, 0x17, 0x00, 0x00, 0x00, 0x02, \
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x02, \
+        0x40, 0x0A, 0x01, 0x00, 0x00, 0x01, \
+        0xA0, 0x0E, 0x0E, 0x00, 0x00, 0x02, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+    PanelInterface::SCRIPT_CMD, 0x22, 42,   \
+        0x40, 0x17, 0x00, 0x00, 0x00, 0x02, \
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x02, \
+        0x40, 0x0A, 0x01, 0x00, 0x00, 0x01, \
+        0xA0, 0x0E, 0x0E, 0x00, 0x00, 0x02, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+    PanelInterface::SCRIPT_CMD, 0x23, 42,   \
+        0x80, 0x17, 0x00, 0x00, 0x00, 0x02, \
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x02, \
+        0x80, 0x0A, 0x01, 0x00, 0x00, 0x01, \
+        0x50, 0x0E, 0x0E, 0x00, 0x00, 0x02, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+    PanelInterface::SCRIPT_CMD, 0x24, 42,   \
+        0x80, 0x17, 0x00, 0x00, 0x00, 0x02, \
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x02, \
+        0x80, 0x0A, 0x01, 0x00, 0x00, 0x01, \
+        0x50, 0x0E, 0x0E, 0x00, 0x00, 0x02, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+
+static constexpr uint8_t EPD_4IN2_init_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x01, 4, 0x03, 0x00, 0x2b, 0x2b,       // power setting
+    PanelInterface::SCRIPT_CMD, 0x06, 3, 0x17, 0x17, 0x17,             // boost soft start A, B, C
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               // power on
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(500),
+    PanelInterface::SCRIPT_CMD, 0x00, 2, 0xbf, 0x0d,                   // panel setting: KW-BF KWR-AF BWROTP 0f BWOTP 1f
+    PanelInterface::SCRIPT_CMD, 0x30, 1, 0x3c,                         // PLL: 3C 50Hz 3A 100HZ 29 150Hz 39 200Hz 31 171Hz
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(WIDTH_4IN2), BE16(HEIGHT_4IN2),  // resolution
+    PanelInterface::SCRIPT_CMD, 0x82, 1, 0x28,                         // vcom_DC setting
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x97,                         // VCOM and data interval: white border
+    EPD_4IN2_FULL_LUTS
+    PanelInterface::SCRIPT_END
+};
+
+// fast waveform: the phases of the full LUTs above with a single repetition,
+// about half of the frames of the full refresh with slightly more ghosting
+static constexpr uint8_t EPD_4IN2_fast_lut_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x20, 44,
+        0x00, 0x17, 0x00, 0x00, 0x00, 0x01,
+        0x00, 0x17, 0x17, 0x00, 0x00, 0x01,
+        0x00, 0x0A, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x0E, 0x0E, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x21, 42,
+        0x40, 0x17, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x01,
+        0x40, 0x0A, 0x01, 0x00, 0x00, 0x01,
+        0xA0, 0x0E, 0x0E, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x22, 42,
+        0x40, 0x17, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x01,
+        0x40, 0x0A, 0x01, 0x00, 0x00, 0x01,
+        0xA0, 0x0E, 0x0E, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x23, 42,
+        0x80, 0x17, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x01,
+        0x80, 0x0A, 0x01, 0x00, 0x00, 0x01,
+        0x50, 0x0E, 0x0E, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x24, 42,
+        0x80, 0x17, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x17, 0x17, 0x00, 0x00, 0x01,
+        0x80, 0x0A, 0x01, 0x00, 0x00, 0x01,
+        0x50, 0x0E, 0x0E, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_END
+};
+
+// the refresh scripts only start the refresh, see waitDisplay(); refresh and
+// sleep are the same for UC8176, UC8179 and IL0371
+static constexpr uint8_t EPD_refresh_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x12, 0,                               // display refresh, about 4 s
+    PanelInterface::SCRIPT_END
+};
+
+static constexpr uint8_t EPD_sleep_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x02, 0,                               // power off
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(200),
+    PanelInterface::SCRIPT_CMD, 0x07, 1, 0xa5,                         // deep sleep with check code
+    PanelInterface::SCRIPT_END
+};
+
+// partial refresh: LUTs of a single short phase, driven by old (0x10) vs.
+// new (0x13) data RAM, the border is left floating
+static constexpr uint8_t EPD_4IN2_partial_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x00, 1, 0x3f,                         // panel setting: LUT set by register
+    PanelInterface::SCRIPT_CMD, 0x82, 1, 0x08,                         // vcom_DC setting
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x17,                         // VCOM and data interval: floating border
+    PanelInterface::SCRIPT_CMD, 0x20, 44,
+        0x00, 0x19, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x21, 42,
+        0x00, 0x19, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x22, 42,
+        0x80, 0x19, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x23, 42,
+        0x40, 0x19, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x24, 42,
+        0x00, 0x19, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x91, 0,                               // partial in
+    PanelInterface::SCRIPT_END
+};
+
+// after a partial refresh: the registers of the init script the partial
+// script changed, without powering on again
+static constexpr uint8_t EPD_4IN2_restore_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x00, 2, 0xbf, 0x0d,                   // panel setting: LUT set by register
+    PanelInterface::SCRIPT_CMD, 0x82, 1, 0x28,                         // vcom_DC setting
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x97,                         // VCOM and data interval: white border
+    EPD_4IN2_FULL_LUTS
+    PanelInterface::SCRIPT_END
+};
+
+// 4 level greyscale
+static constexpr uint8_t EPD_4IN2_4Gray_init_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x01, 5, 0x03, 0x00, 0x2b, 0x2b, 0x13, // power setting
+    PanelInterface::SCRIPT_CMD, 0x06, 3, 0x17, 0x17, 0x17,             // boost soft start A, B, C
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               // power on
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(500),
+    PanelInterface::SCRIPT_CMD, 0x00, 1, 0x3f,                         // panel setting: LUT set by register
+    PanelInterface::SCRIPT_CMD, 0x30, 1, 0x3c,                         // PLL: 50Hz
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(WIDTH_4IN2), BE16(HEIGHT_4IN2),  // resolution
+    PanelInterface::SCRIPT_CMD, 0x82, 1, 0x12,                         // vcom_DC setting
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x97,                         // VCOM and data interval: white border
+    PanelInterface::SCRIPT_END
+};
+
+// the grey waveforms are only valid for the grey RAM content
+static constexpr uint8_t EPD_4IN2_4Gray_refresh_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x20, 44,
+        0x00, 0x0A, 0x00, 0x00, 0x00, 0x01,
+        0x60, 0x14, 0x14, 0x00, 0x00, 0x01,
+        0x00, 0x14, 0x00, 0x00, 0x00, 0x01,
+        0x00, 0x13, 0x0A, 0x01, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x21, 42,
+        0x40, 0x0A, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x14, 0x14, 0x00, 0x00, 0x01,
+        0x10, 0x14, 0x0A, 0x00, 0x00, 0x01,
+        0xA0, 0x13, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x22, 42,
+        0x40, 0x0A, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x14, 0x14, 0x00, 0x00, 0x01,
+        0x00, 0x14, 0x0A, 0x00, 0x00, 0x01,
+        0x99, 0x0C, 0x01, 0x03, 0x04, 0x01,
+        0x02, 0x02, 0x02, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x23, 42,
+        0x40, 0x0A, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x14, 0x14, 0x00, 0x00, 0x01,
+        0x00, 0x14, 0x0A, 0x00, 0x00, 0x01,
+        0x99, 0x0B, 0x04, 0x04, 0x01, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x24, 42,
+        0x80, 0x0A, 0x00, 0x00, 0x00, 0x01,
+        0x90, 0x14, 0x14, 0x00, 0x00, 0x01,
+        0x20, 0x14, 0x0A, 0x00, 0x00, 0x01,
+        0x50, 0x13, 0x01, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    PanelInterface::SCRIPT_CMD, 0x12, 0,                               // display refresh
+    PanelInterface::SCRIPT_END
+};
+
+// ***** UC8176 / UC8179 with waveforms from OTP ****************************
+
+// 4.2" black and white, UC8176
+static constexpr uint8_t GDEW042M01_init_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               // power on
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(1000),
+    PanelInterface::SCRIPT_CMD, 0x00, 1, 0x1f,                         // panel setting: KW mode, LUT from OTP
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(400), BE16(300),         // resolution
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x97,                         // VCOM and data interval: white border
+    PanelInterface::SCRIPT_END
+};
+
+// 4.2" black, white and red, UC8176: the red RAM is 0 for red
+static constexpr uint8_t EPD_4IN2B_init_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x06, 3, 0x17, 0x17, 0x17,             // boost soft start A, B, C
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               // power on
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(1000),
+    PanelInterface::SCRIPT_CMD, 0x00, 1, 0x0f,                         // panel setting: KWR mode, LUT from OTP
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(400), BE16(300),         // resolution
+    PanelInterface::SCRIPT_END
+};
+
+// UC8179 black and white (KW) or black, white and red (KWR) in OTP mode, the
+// black and white RAM is 0 for white in KW mode
+#define UC8179_INIT_SCRIPT(panelSetting, width, height, vcomInterval) { \
+    PanelInterface::SCRIPT_CMD, 0x01, 4, 0x07, 0x07, 0x3f, 0x3f,       /* power setting: VGH/VGL 20 V, VDH/VDL 15 V */ \
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               /* power on */ \
+    PanelInterface::SCRIPT_DELAY, U16(100), \
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(1000), \
+    PanelInterface::SCRIPT_CMD, 0x00, 1, panelSetting,                 /* panel setting, LUT from OTP */ \
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(width), BE16(height),    /* resolution */ \
+    PanelInterface::SCRIPT_CMD, 0x15, 1, 0x00,                         /* dual SPI off */ \
+    PanelInterface::SCRIPT_CMD, 0x50, 2, vcomInterval, 0x07,           /* VCOM and data interval */ \
+    PanelInterface::SCRIPT_CMD, 0x60, 1, 0x22,                         /* TCON */ \
+    PanelInterface::SCRIPT_CMD, 0x65, 4, 0x00, 0x00, 0x00, 0x00,       /* gate and source start */ \
+    PanelInterface::SCRIPT_END \
+}
+
+static constexpr uint8_t GDEW075T7_init_script[] = UC8179_INIT_SCRIPT(0x1f, 800, 480, 0x10);
+static constexpr uint8_t GDEW0583T8_init_script[] = UC8179_INIT_SCRIPT(0x1f, 648, 480, 0x10);
+static constexpr uint8_t GDEW075Z08_init_script[] = UC8179_INIT_SCRIPT(0x0f, 800, 480, 0x11);
+
+// UC8179 fast waveform: the OTP waveform of a forced high temperature
+static constexpr uint8_t UC8179_fast_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x06, 4, 0x27, 0x27, 0x18, 0x17,       // booster soft start
+    PanelInterface::SCRIPT_CMD, 0xe0, 1, 0x02,                         // cascade setting: temperature from 0xe5
+    PanelInterface::SCRIPT_CMD, 0xe5, 1, 0x5a,                         // forced temperature
+    PanelInterface::SCRIPT_END
+};
+
+// UC8179 partial refresh: OTP partial waveform, driven by old vs. new data RAM
+static constexpr uint8_t UC8179_partial_script[] = {
+    PanelInterface::SCRIPT_CMD, 0xe0, 1, 0x02,                         // cascade setting: temperature from 0xe5
+    PanelInterface::SCRIPT_CMD, 0xe5, 1, 0x6e,                         // forced temperature: partial waveform
+    PanelInterface::SCRIPT_CMD, 0x50, 2, 0xa9, 0x07,                   // VCOM and data interval: floating border
+    PanelInterface::SCRIPT_CMD, 0x91, 0,                               // partial in
+    PanelInterface::SCRIPT_END
+};
+
+// UC8179 after a partial refresh: temperature from the sensor again and the
+// border of the init script
+#define UC8179_RESTORE_SCRIPT(vcomInterval) { \
+    PanelInterface::SCRIPT_CMD, 0xe0, 1, 0x00,                         /* cascade setting: internal temperature */ \
+    PanelInterface::SCRIPT_CMD, 0x50, 2, vcomInterval, 0x07,           /* VCOM and data interval */ \
+    PanelInterface::SCRIPT_END \
+}
+
+static constexpr uint8_t GDEW075T7_restore_script[] = UC8179_RESTORE_SCRIPT(0x10);
+
+// ***** IL0371 and ACeP: 4 bpp pixel RAM ***********************************
+
+// IL0371 black and white: pixel codes 0 black, 3 white
+#define IL0371_BW_INIT_SCRIPT(width, height) { \
+    PanelInterface::SCRIPT_CMD, 0x01, 2, 0x37, 0x00,                   /* power setting */ \
+    PanelInterface::SCRIPT_CMD, 0x00, 2, 0xcf, 0x08,                   /* panel setting */ \
+    PanelInterface::SCRIPT_CMD, 0x06, 3, 0xc7, 0xcc, 0x28,             /* boost soft start */ \
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               /* power on */ \
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(1000), \
+    PanelInterface::SCRIPT_CMD, 0x30, 1, 0x3c,                         /* PLL: 50 Hz */ \
+    PanelInterface::SCRIPT_CMD, 0x41, 1, 0x00,                         /* temperature sensor: internal */ \
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x77,                         /* VCOM and data interval */ \
+    PanelInterface::SCRIPT_CMD, 0x60, 1, 0x22,                         /* TCON */ \
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(width), BE16(height),    /* resolution */ \
+    PanelInterface::SCRIPT_CMD, 0x82, 1, 0x1e,                         /* vcom_DC setting */ \
+    PanelInterface::SCRIPT_CMD, 0xe5, 1, 0x03,                         /* flash mode */ \
+    PanelInterface::SCRIPT_END \
+}
+
+// IL0371 black, white and red: pixel codes 0 black, 3 white, 4 red
+#define IL0371_BWR_INIT_SCRIPT(width, height) { \
+    PanelInterface::SCRIPT_CMD, 0x01, 2, 0x37, 0x00,                   /* power setting */ \
+    PanelInterface::SCRIPT_CMD, 0x00, 2, 0xcf, 0x08,                   /* panel setting */ \
+    PanelInterface::SCRIPT_CMD, 0x30, 1, 0x3a,                         /* PLL: 100 Hz */ \
+    PanelInterface::SCRIPT_CMD, 0x82, 1, 0x28,                         /* vcom_DC setting */ \
+    PanelInterface::SCRIPT_CMD, 0x06, 3, 0xc7, 0xcc, 0x15,             /* boost soft start */ \
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x77,                         /* VCOM and data interval */ \
+    PanelInterface::SCRIPT_CMD, 0x60, 1, 0x22,                         /* TCON */ \
+    PanelInterface::SCRIPT_CMD, 0x65, 1, 0x00,                         /* flash control */ \
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(width), BE16(height),    /* resolution */ \
+    PanelInterface::SCRIPT_CMD, 0xe5, 1, 0x03,                         /* flash mode */ \
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               /* power on */ \
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(1000), \
+    PanelInterface::SCRIPT_END \
+}
+
+static constexpr uint8_t GDEW075T8_init_script[] = IL0371_BW_INIT_SCRIPT(640, 384);
+static constexpr uint8_t GDEW0583T7_init_script[] = IL0371_BW_INIT_SCRIPT(600, 448);
+static constexpr uint8_t GDEW075Z09_init_script[] = IL0371_BWR_INIT_SCRIPT(640, 384);
+static constexpr uint8_t GDEW0583Z21_init_script[] = IL0371_BWR_INIT_SCRIPT(600, 448);
+
+// 5.65" 7 colour ACeP: powered on for the refresh only, busy after reset
+static constexpr uint8_t ACEP565_init_script[] = {
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(1000),
+    PanelInterface::SCRIPT_CMD, 0x00, 2, 0xef, 0x08,                   // panel setting
+    PanelInterface::SCRIPT_CMD, 0x01, 4, 0x37, 0x00, 0x23, 0x23,       // power setting
+    PanelInterface::SCRIPT_CMD, 0x03, 1, 0x00,                         // power off sequence
+    PanelInterface::SCRIPT_CMD, 0x06, 3, 0xc7, 0xc7, 0x1d,             // boost soft start
+    PanelInterface::SCRIPT_CMD, 0x30, 1, 0x3c,                         // PLL: 50 Hz
+    PanelInterface::SCRIPT_CMD, 0x41, 1, 0x00,                         // temperature sensor: internal
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x37,                         // VCOM and data interval
+    PanelInterface::SCRIPT_CMD, 0x60, 1, 0x22,                         // TCON
+    PanelInterface::SCRIPT_CMD, 0x61, 4, BE16(600), BE16(448),         // resolution
+    PanelInterface::SCRIPT_CMD, 0xe3, 1, 0xaa,                         // power saving
+    PanelInterface::SCRIPT_DELAY, U16(100),
+    PanelInterface::SCRIPT_CMD, 0x50, 1, 0x37,                         // VCOM and data interval
+    PanelInterface::SCRIPT_END
+};
+
+static constexpr uint8_t ACEP565_refresh_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x04, 0,                               // power on
+    PanelInterface::SCRIPT_WAIT_BUSY, LOW, U16(1000),
+    PanelInterface::SCRIPT_CMD, 0x12, 0,                               // display refresh, about 12 s
+    PanelInterface::SCRIPT_END
+};
+
+static constexpr uint8_t ACEP565_sleep_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x02, 0,                               // power off
+    PanelInterface::SCRIPT_DELAY, U16(200),
+    PanelInterface::SCRIPT_CMD, 0x07, 1, 0xa5,                         // deep sleep with check code
+    PanelInterface::SCRIPT_END
+};
+
+// ***** SSD1677 *************************************************************
+
+// 7.5" HD black, white and red, busy while BUSY is high; RAM window and gate
+// settings as in the vendor sample code, the y address counts down
+static constexpr uint8_t GDEH075Z90_init_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x12, 0,                               // software reset
+    PanelInterface::SCRIPT_WAIT_BUSY, HIGH, U16(1000),
+    PanelInterface::SCRIPT_CMD, 0x46, 1, 0xf7,                         // auto write red RAM
+    PanelInterface::SCRIPT_WAIT_BUSY, HIGH, U16(1000),
+    PanelInterface::SCRIPT_CMD, 0x47, 1, 0xf7,                         // auto write black and white RAM
+    PanelInterface::SCRIPT_WAIT_BUSY, HIGH, U16(1000),
+    PanelInterface::SCRIPT_CMD, 0x0c, 5, 0xae, 0xc7, 0xc3, 0xc0, 0x40, // booster soft start
+    PanelInterface::SCRIPT_CMD, 0x01, 3, 0xaf, 0x02, 0x01,             // driver output control
+    PanelInterface::SCRIPT_CMD, 0x11, 1, 0x01,                         // data entry: x increment, y decrement
+    PanelInterface::SCRIPT_CMD, 0x44, 4, U16(0), U16(879),             // RAM x range
+    PanelInterface::SCRIPT_CMD, 0x45, 4, U16(0x2af), U16(0),           // RAM y range
+    PanelInterface::SCRIPT_CMD, 0x3c, 1, 0x01,                         // border waveform
+    PanelInterface::SCRIPT_CMD, 0x18, 1, 0x80,                         // temperature sensor: internal
+    PanelInterface::SCRIPT_CMD, 0x22, 1, 0xb1,                         // load temperature and waveform
+    PanelInterface::SCRIPT_CMD, 0x20, 0,                               // master activation
+    PanelInterface::SCRIPT_WAIT_BUSY, HIGH, U16(1000),
+    PanelInterface::SCRIPT_END
+};
+
+static constexpr uint8_t SSD1677_refresh_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x22, 1, 0xc7,                         // display update sequence
+    PanelInterface::SCRIPT_CMD, 0x20, 0,                               // master activation, about 16 s
+    PanelInterface::SCRIPT_END
+};
+
+static constexpr uint8_t SSD1677_sleep_script[] = {
+    PanelInterface::SCRIPT_CMD, 0x10, 1, 0x01,                         // deep sleep mode 1
+    PanelInterface::SCRIPT_END
+};
+
+// ***************************************************************************
+
+static constexpr PanelDescriptor::Rgb WHITE[] = { { 255, 255, 255 } };
+static constexpr PanelDescriptor::Rgb WHITE_RED[] = { { 255, 255, 255 }, { 255, 0, 0 } };
+static constexpr PanelDescriptor::Rgb ACEP_COLORS[] = {
+    { 255, 255, 255 }, { 0, 255, 0 }, { 0, 0, 255 }, { 255, 0, 0 }, { 255, 255, 0 }, { 255, 128, 0 }
+};
+// overlays in black: 0 in the black and white plane, not set in the colour planes
+static constexpr uint8_t BLACK[] = { 0, 0, 0, 0, 0, 0 };
+
+static constexpr uint8_t IL0371_BW_CODES[] = { 0x0, 0x3 };
+static constexpr uint8_t IL0371_BWR_CODES[] = { 0x0, 0x3, 0x4 };
+static constexpr uint8_t ACEP_CODES[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6 };
+
+/**
+ * All panels known to the firmware, including all panels of
+ * EPD::setPanel(). GDEW1248T3 has no driver: its four cascaded controllers
+ * need a chip select each, PanelInterface drives one.
+ */
+constexpr PanelDescriptor PANEL_DESCRIPTORS[] = {
+    {
+        "Waveshare-042bw", PanelDescriptor::hashName("Waveshare-042bw"), GxEPD2::GDEW042T2,
+        "GDEW042T2/Waveshare_4_2_bw",
+        WIDTH_4IN2, HEIGHT_4IN2, 1, 1, WHITE, BLACK, 0, nullptr,
+        4000000, LOW, 8000, 2000,
+        EPD_4IN2_init_script, EPD_refresh_script, EPD_sleep_script,
+        EPD_4IN2_fast_lut_script, EPD_4IN2_partial_script, EPD_4IN2_restore_script,
+        { 4100, 2160, 500 }, { 5, 20, 12 * 3600 },
+        PanelUC81xx::create
+    },
+    {
+        "Waveshare-042gray", PanelDescriptor::hashName("Waveshare-042gray"), -1, nullptr,
+        WIDTH_4IN2, HEIGHT_4IN2, 1, 2, WHITE, BLACK, 0, nullptr,
+        4000000, LOW, 10000, 0,
+        EPD_4IN2_4Gray_init_script, EPD_4IN2_4Gray_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 2000, 0, 0 }, { 0, 0, 0 },
+        Panel43gray::create
+    },
+    {
+        "GDEW042M01", PanelDescriptor::hashName("GDEW042M01"), GxEPD2::GDEW042M01, nullptr,
+        400, 300, 1, 1, WHITE, BLACK, 0, nullptr,
+        4000000, LOW, 10000, 0,
+        GDEW042M01_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 4000, 0, 0 }, { 0, 0, 0 },
+        PanelUC81xx::create
+    },
+    {
+        "GDEW0583T7/Waveshare_5_83_bw", PanelDescriptor::hashName("GDEW0583T7/Waveshare_5_83_bw"), GxEPD2::GDEW0583T7, nullptr,
+        600, 448, 1, 1, WHITE, BLACK, 0, IL0371_BW_CODES,
+        4000000, LOW, 10000, 0,
+        GDEW0583T7_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 4500, 0, 0 }, { 0, 0, 0 },
+        PanelPixelRam::create
+    },
+    {
+        "GDEW0583T8", PanelDescriptor::hashName("GDEW0583T8"), GxEPD2::GDEW0583T8, nullptr,
+        648, 480, 1, 1, WHITE, BLACK, 0x01, nullptr,
+        10000000, LOW, 10000, 0,
+        GDEW0583T8_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 4000, 0, 0 }, { 0, 0, 0 },
+        PanelUC81xx::create
+    },
+    {
+        "GDEW075T8/Waveshare_7_5_bw", PanelDescriptor::hashName("GDEW075T8/Waveshare_7_5_bw"), GxEPD2::GDEW075T8, nullptr,
+        640, 384, 1, 1, WHITE, BLACK, 0, IL0371_BW_CODES,
+        4000000, LOW, 10000, 0,
+        GDEW075T8_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 4500, 0, 0 }, { 0, 0, 0 },
+        PanelPixelRam::create
+    },
+    {
+        "GDEW075T7/Waveshare_7_5_bw_T7", PanelDescriptor::hashName("GDEW075T7/Waveshare_7_5_bw_T7"), GxEPD2::GDEW075T7, nullptr,
+        800, 480, 1, 1, WHITE, BLACK, 0x01, nullptr,
+        10000000, LOW, 10000, 2000,
+        GDEW075T7_init_script, EPD_refresh_script, EPD_sleep_script,
+        UC8179_fast_script, UC8179_partial_script, GDEW075T7_restore_script,
+        { 4000, 1500, 1000 }, { 5, 20, 12 * 3600 },
+        PanelUC81xx::create
+    },
+    {
+        "GDEW1248T3/Waveshare_12_24_bw", PanelDescriptor::hashName("GDEW1248T3/Waveshare_12_24_bw"), GxEPD2::GDEW1248T3, nullptr,
+        1304, 984, 1, 1, WHITE, BLACK, 0, nullptr,
+        4000000, LOW, 10000, 0,
+        nullptr, nullptr, nullptr,
+        nullptr, nullptr, nullptr,
+        { 0, 0, 0 }, { 0, 0, 0 },
+        nullptr
+    },
+    {
+        "GDEW042Z15/Waveshare_4_2_bwr", PanelDescriptor::hashName("GDEW042Z15/Waveshare_4_2_bwr"), GxEPD2::GDEW042Z15, nullptr,
+        400, 300, 2, 1, WHITE_RED, BLACK, 0x02, nullptr,
+        4000000, LOW, 20000, 0,
+        EPD_4IN2B_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 15000, 0, 0 }, { 0, 0, 0 },
+        PanelUC81xx::create
+    },
+    {
+        "GDEW0583Z21/Waveshare_5_83_bwr", PanelDescriptor::hashName("GDEW0583Z21/Waveshare_5_83_bwr"), GxEPD2::GDEW0583Z21, nullptr,
+        600, 448, 2, 1, WHITE_RED, BLACK, 0, IL0371_BWR_CODES,
+        4000000, LOW, 20000, 0,
+        GDEW0583Z21_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 15000, 0, 0 }, { 0, 0, 0 },
+        PanelPixelRam::create
+    },
+    {
+        "ACeP565/Waveshare_5_65_7c", PanelDescriptor::hashName("ACeP565/Waveshare_5_65_7c"), GxEPD2::ACeP565, nullptr,
+        600, 448, 6, 1, ACEP_COLORS, BLACK, 0, ACEP_CODES,
+        4000000, LOW, 30000, 0,
+        ACEP565_init_script, ACEP565_refresh_script, ACEP565_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 12000, 0, 0 }, { 0, 0, 0 },
+        PanelPixelRam::create
+    },
+    {
+        "GDEW075Z09/Waveshare_7_5_bwr", PanelDescriptor::hashName("GDEW075Z09/Waveshare_7_5_bwr"), GxEPD2::GDEW075Z09, nullptr,
+        640, 384, 2, 1, WHITE_RED, BLACK, 0, IL0371_BWR_CODES,
+        4000000, LOW, 20000, 0,
+        GDEW075Z09_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 15000, 0, 0 }, { 0, 0, 0 },
+        PanelPixelRam::create
+    },
+    {
+        "GDEW075Z08/Waveshare_7_5_bwr_Z08", PanelDescriptor::hashName("GDEW075Z08/Waveshare_7_5_bwr_Z08"), GxEPD2::GDEW075Z08, nullptr,
+        800, 480, 2, 1, WHITE_RED, BLACK, 0, nullptr,
+        10000000, LOW, 20000, 0,
+        GDEW075Z08_init_script, EPD_refresh_script, EPD_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 16000, 0, 0 }, { 0, 0, 0 },
+        PanelUC81xx::create
+    },
+    {
+        "GDEH075Z90/Waveshare_7_5_bwr_Z90", PanelDescriptor::hashName("GDEH075Z90/Waveshare_7_5_bwr_Z90"), GxEPD2::GDEH075Z90, nullptr,
+        880, 528, 2, 1, WHITE_RED, BLACK, 0, nullptr,
+        10000000, HIGH, 20000, 0,
+        GDEH075Z90_init_script, SSD1677_refresh_script, SSD1677_sleep_script,
+        nullptr, nullptr, nullptr,
+        { 16000, 0, 0 }, { 0, 0, 0 },
+        PanelSSD1677::create
+    },
+};
+constexpr size_t PANEL_DESCRIPTOR_COUNT = sizeof(PANEL_DESCRIPTORS) / sizeof(PANEL_DESCRIPTORS[0]);
+
+static constexpr bool hasUniqueNameHashes()
+{
+    for (size_t i = 0; i < PANEL_DESCRIPTOR_COUNT; i++)
+    {
+        for (size_t j = i + 1; j < PANEL_DESCRIPTOR_COUNT; j++)
+        {
+            if (PANEL_DESCRIPTORS[i].nameHash == PANEL_DESCRIPTORS[j].nameHash)
+                return false;
+        }
+    }
+    return true;
+}
+static_assert(hasUniqueNameHashes(), "panel name hash collision, rename a panel");
+
+static constexpr bool hasRestoreScripts()
+{
+    for (size_t i = 0; i < PANEL_DESCRIPTOR_COUNT; i++)
+    {
+        if (PANEL_DESCRIPTORS[i].partialScript != nullptr && PANEL_DESCRIPTORS[i].restoreScript == nullptr)
+            return false;
+    }
+    return true;
+}
+static_assert(hasRestoreScripts(), "a panel with a partial script needs a restore script");
+
+const PanelDescriptor *PanelDescriptor::find(const char *name)
+{
+    const uint32_t hash = hashName(name);
+    for (const auto& descriptor: PANEL_DESCRIPTORS)
+    {
+        if (descriptor.nameHash == hash && strcmp(descriptor.name, name) == 0)
+            return &descriptor;
+    }
+    // former names are rare, no hashes for them
+    for (const auto& descriptor: PANEL_DESCRIPTORS)
+    {
+        if (descriptor.alias != nullptr && strcmp(descriptor.alias, name) == 0)
+            return &descriptor;
+    }
+    return nullptr;
+}
+
+const PanelDescriptor *PanelDescriptor::findGxEPD2(int gxepd2Panel)
+{
+    for (const auto& descriptor: PANEL_DESCRIPTORS)
+    {
+        if (descriptor.gxepd2Panel == gxepd2Panel)
+            return &descriptor;
+    }
+    return nullptr;
+}
+
+// ***************************************************************************
+
+Panel::Panel(const PanelDescriptor& descriptor):
+    _descriptor(descriptor),
+    pIf(nullptr),
+    _refreshMode(REFRESH_FULL)
+{
+    for (int channel = 0; channel < descriptor.channels; channel++)
+    {
+        const PanelDescriptor::Rgb& c = descriptor.channelColors[channel];
+        _rgbColors.push_back(std::make_tuple(c.r, c.g, c.b));
+    }
+}
+
+void Panel::writeChannel(int channel, const uint8_t *data)
+{
+    for (int pass = 0; pass < getChannelPasses(channel); pass++)
+    {
+        beginChannel(channel, pass);
+        writeRows(data, getHeight());
+        endChannel();
+    }
+}
+
+void Panel::displayPartial(const uint8_t *previous, const uint8_t *current, const DiffRect& rect)
+{
+    writeChannel(0, current);
+    display();
+}
 
 // ***************************************************************************
 
-void Panel43bw::init(PanelInterface *pIf)
+void Panel::init(PanelInterface *pIf)
 {
     this->pIf = pIf;
+    pIf->setSpiClock(_descriptor.spiClock_hz);
     pIf->reset(_before_reset_ms, _reset_duration_ms, _after_reset_ms);
+    if (!pIf->runScript(_descriptor.initScript))
+    {
+        ESP_LOGE(__FILE__, "%s(%d) Init script failed in init()!", __FILE__, __LINE__);
+    }
+}
+
+void Panel::deep_sleep()
+{
+    if (!pIf->runScript(_descriptor.sleepScript))
+    {
+        ESP_LOGW(__FILE__, "%s(%d) Sleep script failed in deep_sleep()!", __FILE__, __LINE__);
+    }
+}
+
+/// The full LUTs are loaded by init(), the fast ones replace them until the next init()
+void Panel::startDisplay()
+{
+    if (_refreshMode == REFRESH_FAST && supportsFastRefresh())
+    {
+        pIf->runScript(_descriptor.fastLutScript);
+    }
+    pIf->runScript(_descriptor.refreshScript);
+    pIf->flushQueue();   // refresh command on the wire
+}
+
+bool Panel::waitDisplay()
+{
+    if (!pIf->waitUntilNotBusy(_descriptor.busyLevel, _descriptor.refreshTimeout_ms))
+    {
+        ESP_LOGW(__FILE__, "%s(%d) Busy timeout expired in waitDisplay()!", __FILE__, __LINE__);
+        return false;
+    }
+    return true;
+}
+
+// ***************************************************************************
+
+/**
+ * Single channel panels: the old data RAM is white for full refreshes, the
+ * new data RAM is written completely. Two channel panels: channel 0 goes
+ * to the old data RAM, channel 1 to the new one.
+ */
+void PanelUC81xx::beginChannel(int channel, int pass)
+{
+    const int planeBytes = ( getWidth() + 7 ) / 8 * getHeight();
+    if (getChannels() == 1)
+    {
+        pIf->writeCommand(0x10);
+        pIf->writeData(isInverted(0) ? 0x00 : 0xff, planeBytes);
+    }
+    _isInverted = isInverted(channel);
+    pIf->writeCommand(getChannels() == 1 || channel == 1 ? 0x13 : 0x10);
+    pIf->startDataTransfer();
+}
+
+void PanelUC81xx::writeRows(const uint8_t *rows, int numRows)
+{
+    const size_t numBytes = ( getWidth() + 7 ) / 8 * numRows;
+    if (!_isInverted)
+    {
+        pIf->transferData(rows, numBytes);
+        return;
+    }
+    _rows.resize(numBytes);
+    for (size_t i = 0; i < numBytes; i++)
+    {
+        _rows[i] = ~rows[i];
+    }
+    pIf->transferData(_rows.data(), numBytes);
+}
+
+void PanelUC81xx::endChannel()
+{
+    pIf->endDataTransfer();
+}
+
+// ***************************************************************************
+
+/**
+ * Loads the partial LUTs and writes the window of the previous frame to the
+ * old data RAM and of the current frame to the new data RAM, the LUTs drive
+ * the pixels by their transition. Only the window is transferred and
+ * refreshed. The restore script of the descriptor undoes the register
+ * changes of the partial script for a later display().
+ */
+void PanelUC81xx::displayPartial(const uint8_t *previous, const uint8_t *current, const DiffRect& rect)
+{
+    if (!supportsPartialRefresh())
+    {
+        Panel::displayPartial(previous, current, rect);
+        return;
+    }
+    const int x0 = (rect.x < 0 ? 0 : rect.x) & ~7;
+    const int y0 = rect.y < 0 ? 0 : rect.y;
+    const int x1 = rect.x + rect.w < getWidth() ? rect.x + rect.w : getWidth();
+    const int y1 = rect.y + rect.h < getHeight() ? rect.y + rect.h : getHeight();
+    if (x1 <= x0 || y1 <= y0)
+        return;
 
-    pIf->writeCommand(0x01); // POWER SETTING
-    pIf->writeData(0x03);
-    pIf->writeData(0x00);
-    pIf->writeData(0x2b);
-    pIf->writeData(0x2b);
-
-    pIf->writeCommand(0x06); // boost soft start
-    pIf->writeData(0x17);		//A
-    pIf->writeData(0x17);		//B
-    pIf->writeData(0x17);		//C
-
-    pIf->writeCommand(0x04); // POWER_ON
-    if (!pIf->waitUntilNotBusy(LOW, _power_on_timeout_ms))
-    {
-        ESP_LOGE(__FILE__, "%s(%d) Busy timeout expired on POWER_ON in init()!", __FILE__, __LINE__);
-    }
-
-    pIf->writeCommand(0x00); // panel setting
-    pIf->writeData(0xbf); // KW-BF   KWR-AF	BWROTP 0f	BWOTP 1f
-    pIf->writeData(0x0d);
-/*
-    pIf->writeCommand(0x00); // panel setting
-    pIf->writeData(0x3f); // 300x400, B/W, LUT set by register
-*/
-    pIf->writeCommand(0x30); // PLL setting
-    pIf->writeData(0x3C); // 3C 50Hz  3A 100HZ  29 150Hz  39 200Hz  31 171Hz
-
-    pIf->writeCommand(0x61); // resolution setting
-    pIf->writeData( getWidth() / 256 );
-    pIf->writeData( getWidth() % 256 );
-    pIf->writeData( getHeight() / 256 );
-    pIf->writeData( getHeight() % 256 );
-
-/*
-    pIf->writeCommand(0x82); // vcom_DC setting
-    pIf->writeData(0x12);
-*/
-    pIf->writeCommand(0x82); // vcom_DC setting
-    pIf->writeData(0x28);
-
-    pIf->writeCommand(0X50); // VCOM AND DATA INTERVAL SETTING
-    pIf->writeData(0x97); // 97white border 77black border		VBDF 17|D7 VBDW 97 VBDB 57		VBDF F7 VBDW 77 VBDB 37  VBDR B7
-    // ??? 0xd7 ???
-
-    // set LUT
-    pIf->writeCommand(0x20); pIf->writeData(EPD_4IN2_lut_vcom0, 44);
-    pIf->writeCommand(0x21); pIf->writeData(EPD_4IN2_lut_ww, 42);
-    pIf->writeCommand(0x22); pIf->writeData(EPD_4IN2_lut_bw, 42);
-    pIf->writeCommand(0x23); pIf->writeData(EPD_4IN2_lut_wb, 42);
-    pIf->writeCommand(0x24); pIf->writeData(EPD_4IN2_lut_bb, 42);
-
-    // initialize RAM
-    pIf->writeCommand(0x10); pIf->writeData(0xff, getWidth() * getHeight() / 8);
-    pIf->writeCommand(0x13); pIf->writeData(0xff, getWidth() * getHeight() / 8);
+    // HRST[8:3], HRED[8:3] inclusive, VRST[8:0], VRED[8:0], scan inside the window only
+    const int xe = (x1 - 1) | 7;
+    const uint8_t window[] = {
+        BE16(x0), BE16(xe), BE16(y0), BE16(y1 - 1), 0x01
+    };
+    pIf->runScript(_descriptor.partialScript);
+    pIf->writeCommand(0x90, window, sizeof(window));
+    writeWindow(0x10, previous, x0, y0, xe + 1, y1);
+    writeWindow(0x13, current, x0, y0, xe + 1, y1);
+
+    pIf->writeCommand(0x12);
+    if (!pIf->waitUntilNotBusy(_descriptor.busyLevel, _descriptor.partialTimeout_ms))
+    {
+        ESP_LOGW(__FILE__, "%s(%d) Busy timeout expired in displayPartial()!", __FILE__, __LINE__);
+    }
+    pIf->writeCommand(0x92);    // partial out
+    pIf->runScript(_descriptor.restoreScript);
+}
+
+/// Rows of the window x0 <= x < x1 (multiples of 8), y0 <= y < y1 of a plane of channel 0
+void PanelUC81xx::writeWindow(uint8_t command, const uint8_t *plane, int x0, int y0, int x1, int y1)
+{
+    const int stride = ( getWidth() + 7 ) / 8;
+    const int numBytes = (x1 - x0) / 8;
+    pIf->writeCommand(command);
+    pIf->startDataTransfer();
+    for (int y = y0; y < y1; y++)
+    {
+        const uint8_t *src = plane + y * stride + x0 / 8;
+        if (isInverted(0))
+        {
+            _rows.resize(numBytes);
+            for (int i = 0; i < numBytes; i++)
+            {
+                _rows[i] = ~src[i];
+            }
+            src = _rows.data();
+        }
+        pIf->transferData(src, numBytes);
+    }
+    pIf->endDataTransfer();
 }
 
 // ***************************************************************************
 
-void Panel43bw::deep_sleep()
+/**
+ * The first pass streams the high bit of every 2 bpp pixel to the "old"
+ * data RAM, the second pass the low bit to the "new" data RAM.
+ */
+void Panel43gray::beginChannel(int channel, int pass)
+{
+    _highBits = pass == 0;
+    pIf->writeCommand(_highBits ? 0x10 : 0x13);
+    pIf->startDataTransfer();
+}
+
+/// Converts 8 pixels at a time, the rows are queued as a whole
+void Panel43gray::writeRows(const uint8_t *rows, int numRows)
 {
-    pIf->writeCommand(0x02); // power off
-    if (!pIf->waitUntilNotBusy(LOW, _power_off_timeout_ms))
+    const int srcStride = ( getWidth() * 2 + 7 ) / 8;
+    const int dstStride = ( getWidth() + 7 ) / 8;
+    _rows.resize(dstStride * numRows);
+
+    uint8_t *dst = _rows.data();
+    for (int y = 0; y < numRows; y++)
     {
-        ESP_LOGW(__FILE__, "%s(%d) Busy timeout expired in hibernate()!", __FILE__, __LINE__);
+        const uint8_t *src = rows + y * srcStride;
+        for (int i = 0; i < dstStride; i++)
+        {
+            uint8_t high, low;
+            BitOps::splitGreyPixels(src + 2*i, high, low);
+            *dst++ = _highBits ? high : low;
+        }
     }
-    pIf->writeCommand(0x07); // deep sleep
-    pIf->writeData(0xA5);    // check code
+    pIf->transferData(_rows.data(), _rows.size());
 }
 
 // ***************************************************************************
 
-void Panel43bw::writeChannel(int channel, const uint8_t *data)
+PanelPixelRam::~PanelPixelRam()
+{
+    releasePlanes();
+}
+
+void PanelPixelRam::releasePlanes()
+{
+    if (_planes != nullptr)
+    {
+        MemoryPlanner::release(MemoryPlanner::PANEL, _planes);
+        _planes = nullptr;
+    }
+}
+
+/// All channels but the last one, 1 bpp each
+size_t PanelPixelRam::getPlaneBufferSize() const
+{
+    return ( getWidth() + 7 ) / 8 * getHeight() * (getChannels() - 1);
+}
+
+/// Channels before the last one are buffered, the last one starts the transfer to 0x10
+void PanelPixelRam::beginChannel(int channel, int pass)
 {
-    pIf->writeCommand(0x13);
-    pIf->writeData(data, ( getWidth() + 7 ) / 8 * getHeight());
+    _channel = channel;
+    _row = 0;
+    if (channel < getChannels() - 1)
+    {
+        if (_planes == nullptr)
+        {
+            _planes = (uint8_t *) MemoryPlanner::allocate(MemoryPlanner::PANEL, getPlaneBufferSize());
+            if (_planes == nullptr)
+            {
+                ESP_LOGE(__FILE__, "%s(%d) Out of memory for %d planes in beginChannel()!",
+                    __FILE__, __LINE__, getChannels() - 1);
+            }
+        }
+        return;
+    }
+    if (getChannels() > 1 && _planes == nullptr)
+    {
+        ESP_LOGE(__FILE__, "%s(%d) No channel planes, only channel %d is shown!", __FILE__, __LINE__, channel);
+    }
+    pIf->writeCommand(0x10);
+    pIf->startDataTransfer();
+}
+
+/**
+ * A pixel is black (colorCodes[0]) unless the bit of a channel is set, the
+ * last channel with a set bit gives its colour. Two pixels per byte, the
+ * left one in the high nibble.
+ */
+void PanelPixelRam::writeRows(const uint8_t *rows, int numRows)
+{
+    const int stride = ( getWidth() + 7 ) / 8;
+    const size_t planeBytes = stride * getHeight();
+    if (_channel < getChannels() - 1)
+    {
+        if (_planes != nullptr)
+        {
+            memcpy(_planes + _channel * planeBytes + _row * stride, rows, stride * numRows);
+        }
+        _row += numRows;
+        return;
+    }
+
+    const uint8_t *codes = _descriptor.colorCodes;
+    const int rowBytes = ( getWidth() + 1 ) / 2;
+    _rows.resize(rowBytes * numRows);
+    uint8_t *dst = _rows.data();
+    for (int y = 0; y < numRows; y++, _row++)
+    {
+        for (int x = 0; x < rowBytes * 2; x++)
+        {
+            const int offset = _row * stride + x / 8;
+            const uint8_t mask = 0x80 >> (x & 7);
+            uint8_t code = codes[0];
+            for (int channel = 0; channel < getChannels() - 1 && _planes != nullptr; channel++)
+            {
+                if (_planes[channel * planeBytes + offset] & mask)
+                    code = codes[1 + channel];
+            }
+            if (x < getWidth() && (rows[y * stride + x / 8] & mask))
+                code = codes[getChannels()];
+            if (x & 1)
+                *dst++ |= code;
+            else
+                *dst = code << 4;
+        }
+    }
+    pIf->transferData(_rows.data(), _rows.size());
 }
 
-void Panel43bw::display()
+void PanelPixelRam::endChannel()
 {
-    pIf->writeCommand(0x12); // display refresh
-    if (!pIf->waitUntilNotBusy(LOW, _refresh_timeout_ms))
+    if (_channel == getChannels() - 1)
     {
-        ESP_LOGW(__FILE__, "%s(%d) Busy timeout expired in display()!", __FILE__, __LINE__);
+        pIf->endDataTransfer();
+        releasePlanes();
     }
 }
 
 // ***************************************************************************
+
+/// The y address counts down from the top row, see the data entry mode of the init script
+void PanelSSD1677::beginChannel(int channel, int pass)
+{
+    static const uint8_t x_counter[] = { 0x00, 0x00 };
+    static const uint8_t y_counter[] = { 0xaf, 0x02 };
+    pIf->writeCommand(0x4e, x_counter, sizeof(x_counter));
+    pIf->writeCommand(0x4f, y_counter, sizeof(y_counter));
+    pIf->writeCommand(channel == 0 ? 0x24 : 0x26);
+    pIf->startDataTransfer();
+}
+
+void PanelSSD1677::writeRows(const uint8_t *rows, int numRows)
+{
+    pIf->transferData(rows, ( getWidth() + 7 ) / 8 * numRows);
+}
+
+void PanelSSD1677::endChannel()
+{
+    pIf->endDataTransfer();
+}
+
+// ***************************************************************************
@@ -8,65 +8,191 @@
 #include <tuple>
 #include <vector>
 
+#include "FrameDiff.h"
+#include "PanelDescriptor.h"
 #include "PanelInterface.h"
 
 // ***************************************************************************
 
+/**
+ * Driver of a controller family, the panel specific values are taken from
+ * the PanelDescriptor the panel is created with, see PanelFactory.
+ */
 class Panel
 {
 public:
     typedef std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> RgbColors;
-    Panel(): pIf(nullptr) {};
+    typedef PanelDescriptor::GhostingBudget GhostingBudget;
+    typedef PanelDescriptor::RefreshTimes RefreshTimes;
+    enum RefreshMode: uint8_t { REFRESH_FULL, REFRESH_FAST };
 
-    virtual const char *getName() const = 0;
-    virtual const int getChannels() const = 0;
-    virtual const int getBitsPerChannel() const = 0;
-    virtual const int getWidth() const = 0;
-    virtual const int getHeight() const = 0;
+    Panel(const PanelDescriptor& descriptor);
+    virtual ~Panel() {}
 
-    virtual const RgbColors& getChannelRgbColors() const = 0;
-    virtual const int getDefaultColor(int channel) const = 0;
+    const PanelDescriptor& getDescriptor() const { return _descriptor; }
+    const char *getName() const { return _descriptor.name; }
+    int getChannels() const { return _descriptor.channels; }
+    int getBitsPerChannel() const { return _descriptor.bitsPerChannel; }
+    int getWidth() const { return _descriptor.width; }
+    int getHeight() const { return _descriptor.height; }
+    int getSpiClock_hz() const { return _descriptor.spiClock_hz; }
 
-    virtual void init(PanelInterface *pIf) = 0;
-    virtual void deep_sleep() = 0;
+    const RgbColors& getChannelRgbColors() const { return _rgbColors; }
+    int getDefaultColor(int channel) const { return _descriptor.defaultColors[channel]; }
 
-    virtual void writeChannel(int channel, const uint8_t *data) = 0;
-    virtual void display() = 0;
+    /// Resets the controller and runs the init script of the descriptor
+    virtual void init(PanelInterface *pIf);
+    virtual void deep_sleep();
+
+    /**
+     * Streaming transfer of a channel in rows of the panel layout, e.g. for
+     * frames rendered band by band. Some panels need more than one pass
+     * over the frame per channel, each started with beginChannel().
+     */
+    virtual int getChannelPasses(int channel) const { return 1; }
+    virtual void beginChannel(int channel, int pass = 0) = 0;
+    virtual void writeRows(const uint8_t *rows, int numRows) = 0;
+    virtual void endChannel() = 0;
+
+    virtual void writeChannel(int channel, const uint8_t *data);
+    /// Memory the driver allocates to merge the channels, see MemoryPlanner::PANEL
+    virtual size_t getPlaneBufferSize() const { return 0; }
+
+    /**
+     * A refresh is started by startDisplay(), which returns while the panel
+     * is still busy, and completed by waitDisplay(). Panels on the same bus
+     * refresh at the same time if all are started before the first wait.
+     */
+    virtual void startDisplay();
+    virtual bool waitDisplay();
+    void display() { startDisplay(); waitDisplay(); }
+
+    /// Waveform of the following refreshes, ignored by panels without a fast one
+    bool supportsFastRefresh() const { return _descriptor.fastLutScript != nullptr; }
+    GhostingBudget getGhostingBudget() const { return _descriptor.ghostingBudget; }
+    RefreshTimes getRefreshTimes() const { return _descriptor.refreshTimes; }
+    void setRefreshMode(RefreshMode mode) { _refreshMode = mode; }
+
+    /**
+     * Refreshes only the window rect (panel pixels, see DiffRect) of a
+     * single channel panel. previous is the displayed frame, current the new
+     * one, both complete planes in panel layout. Panels without partial
+     * refresh fall back to a full refresh of current.
+     */
+    bool supportsPartialRefresh() const { return _descriptor.partialScript != nullptr; }
+    virtual void displayPartial(const uint8_t *previous, const uint8_t *current, const DiffRect& rect);
 
 protected:
+    const PanelDescriptor& _descriptor;
     PanelInterface *pIf;
+    RefreshMode _refreshMode;
+    RgbColors _rgbColors;
+
+    const uint32_t _before_reset_ms = 200;
+    const uint32_t _reset_duration_ms = 200;
+    const uint32_t _after_reset_ms = 200;
 };
 
 // ***************************************************************************
 
-class Panel43bw: public Panel
+/**
+ * UC8176 (4.2") and UC8179 (5.83", 7.5") controllers with two 1 bpp data
+ * RAMs. Black and white panels get their frame in the "new" RAM (0x13),
+ * the "old" RAM (0x10) is cleared to white for full refreshes and holds the
+ * previous frame for partial ones. Black, white and red panels get the
+ * black and white plane in 0x10 and the red plane in 0x13. The channels in
+ * PanelDescriptor::invertedChannels are sent inverted.
+ */
+class PanelUC81xx: public Panel
 {
 public:
-    Panel43bw(): Panel() {};
+    PanelUC81xx(const PanelDescriptor& descriptor): Panel(descriptor), _isInverted(false) {};
+    static Panel *create(const PanelDescriptor& descriptor) { return new PanelUC81xx(descriptor); }
 
-    virtual const char *getName() const { return "Waveshare-042bw"; };
-    virtual const int getChannels() const { return 1; }
-    virtual const int getBitsPerChannel() const { return 1; }
-    virtual const int getWidth() const { return 400; }
-    virtual const int getHeight() const { return 300; }
+    virtual void beginChannel(int channel, int pass = 0);
+    virtual void writeRows(const uint8_t *rows, int numRows);
+    virtual void endChannel();
 
-    virtual const RgbColors& getChannelRgbColors() const { return _rgbColors; }
-    virtual const int getDefaultColor(int channel) const { return 0; }
+    virtual void displayPartial(const uint8_t *previous, const uint8_t *current, const DiffRect& rect);
 
-    virtual void init(PanelInterface *pIf);
-    virtual void deep_sleep();
+protected:
+    bool isInverted(int channel) const { return (_descriptor.invertedChannels >> channel) & 1; }
+    void writeWindow(uint8_t command, const uint8_t *plane, int x0, int y0, int x1, int y1);
 
-    virtual void writeChannel(int channel, const uint8_t *data);
-    virtual void display();
+    bool _isInverted;
+    std::vector<uint8_t> _rows;
+};
+
+// ***************************************************************************
+
+/**
+ * 4.2" panel driven in 4 level greyscale mode. The pixel buffer holds 2 bpp
+ * (0 = black ... 3 = white), which is split into the two controller RAM
+ * planes: the high bits go to the "old" data RAM (0x10), the low bits to the
+ * "new" data RAM (0x13). The grey waveform LUTs map the 4 combinations to
+ * 4 grey levels. Its descriptor has neither a fast nor a partial waveform,
+ * those LUTs are black and white only.
+ */
+class Panel43gray: public PanelUC81xx
+{
+public:
+    Panel43gray(const PanelDescriptor& descriptor): PanelUC81xx(descriptor) {};
+    static Panel *create(const PanelDescriptor& descriptor) { return new Panel43gray(descriptor); }
+
+    virtual int getChannelPasses(int channel) const { return 2; }
+    virtual void beginChannel(int channel, int pass = 0);
+    virtual void writeRows(const uint8_t *rows, int numRows);
 
 protected:
-    const uint32_t _before_reset_ms = 200;
-    const uint32_t _reset_duration_ms = 200;
-    const uint32_t _after_reset_ms = 200;
-    const uint32_t _power_off_timeout_ms = 200;
-    const uint32_t _power_on_timeout_ms = 500;
-    const uint32_t _refresh_timeout_ms = 200;
-    static const RgbColors _rgbColors;
+    bool _highBits;
+};
+
+// ***************************************************************************
+
+/**
+ * Controllers with a single 4 bpp pixel RAM (0x10), IL0371 and the ACeP
+ * UC8159: every pixel is a colour code, see PanelDescriptor::colorCodes.
+ * Single channel panels are converted row by row. With more channels, all
+ * but the last one are kept as 1 bpp planes, and the last one is merged
+ * with them row by row while it is streamed.
+ */
+class PanelPixelRam: public Panel
+{
+public:
+    PanelPixelRam(const PanelDescriptor& descriptor): Panel(descriptor),
+        _channel(0), _row(0), _planes(nullptr) {};
+    virtual ~PanelPixelRam();
+    static Panel *create(const PanelDescriptor& descriptor) { return new PanelPixelRam(descriptor); }
+
+    virtual void beginChannel(int channel, int pass = 0);
+    virtual void writeRows(const uint8_t *rows, int numRows);
+    virtual void endChannel();
+    virtual size_t getPlaneBufferSize() const;
+
+protected:
+    void releasePlanes();
+
+    int _channel;
+    int _row;
+    uint8_t *_planes;   //< channels 0 .. channels - 2
+    std::vector<uint8_t> _rows;
+};
+
+// ***************************************************************************
+
+/**
+ * SSD1677 controller (7.5" HD, 880x528) with a black and white RAM (0x24)
+ * and a red RAM (0x26)
+ */
+class PanelSSD1677: public Panel
+{
+public:
+    PanelSSD1677(const PanelDescriptor& descriptor): Panel(descriptor) {};
+    static Panel *create(const PanelDescriptor& descriptor) { return new PanelSSD1677(descriptor); }
+
+    virtual void beginChannel(int channel, int pass = 0);
+    virtual void writeRows(const uint8_t *rows, int numRows);
+    virtual void endChannel();
 };
 
 // ***************************************************************************
@@ -0,0 +1,107 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ***************************************************************************
+
+class Panel;
+
+/**
+ * Everything which distinguishes one panel type from another of the same
+ * controller family: geometry, channels and their colours, controller
+ * scripts and waveforms (see PanelInterface::runScript()), SPI clock and
+ * busy timing. The descriptors form a constexpr table in Panel.cpp,
+ * PANEL_DESCRIPTORS, which is the only list of panels known to the
+ * firmware. The Panel classes implement a controller family and take all
+ * panel specific values from their descriptor.
+ *
+ * Panels are looked up by the FNV-1a hash of their name, computed at
+ * compile time for the table. No panel is instantiated before create() is
+ * called for it.
+ */
+struct PanelDescriptor
+{
+    struct Rgb
+    {
+        uint8_t r, g, b;
+    };
+
+    /**
+     * Fast and partial refreshes leave ghosts, a clean full refresh is due
+     * after maxFastRefreshes fast ones or maxAge_s seconds after the last
+     * one. A fast refresh is due after maxPartialRefreshes partial ones.
+     */
+    struct GhostingBudget
+    {
+        uint8_t maxFastRefreshes;
+        uint8_t maxPartialRefreshes;
+        uint32_t maxAge_s;
+    };
+
+    /// Nominal busy times of the waveforms, 0 if unsupported
+    struct RefreshTimes
+    {
+        uint32_t full_ms;
+        uint32_t fast_ms;
+        uint32_t partial_ms;
+    };
+
+    const char *name;
+    uint32_t nameHash;              //< hashName(name)
+    int gxepd2Panel;                //< GxEPD2::Panel of the same panel, -1 if none
+    const char *alias;              //< former name, still reported and found, nullptr if none
+
+    uint16_t width;
+    uint16_t height;
+    uint8_t channels;
+    uint8_t bitsPerChannel;
+    const Rgb *channelColors;       //< one per channel
+    const uint8_t *defaultColors;   //< one per channel, for overlays
+    uint8_t invertedChannels;       //< bit per channel sent inverted to the controller
+    /// 4 bpp pixel RAM only: code of black, then of each channel colour
+    const uint8_t *colorCodes;
+
+    int spiClock_hz;
+    int busyLevel;                  //< level of BUSY while the controller is busy
+    uint32_t refreshTimeout_ms;
+    uint32_t partialTimeout_ms;
+
+    const uint8_t *initScript;
+    const uint8_t *refreshScript;   //< starts the refresh, see Panel::startDisplay()
+    const uint8_t *sleepScript;
+    const uint8_t *fastLutScript;   //< nullptr without a fast waveform
+    const uint8_t *partialScript;   //< nullptr without partial refresh
+    const uint8_t *restoreScript;   //< undoes partialScript after partial out, no power on
+
+    RefreshTimes refreshTimes;
+    GhostingBudget ghostingBudget;
+
+    /// New instance driving this panel, nullptr if there is no native driver
+    Panel *(*create)(const PanelDescriptor& descriptor);
+
+    static constexpr uint32_t hashName(const char *name)
+    {
+        uint32_t hash = 2166136261u;
+        while (*name != 0)
+        {
+            hash = (hash ^ (uint8_t) *name++) * 16777619u;
+        }
+        return hash;
+    }
+
+    /// Descriptor of a panel name or alias, nullptr if unknown
+    static const PanelDescriptor *find(const char *name);
+    /// Descriptor of a GxEPD2::Panel, nullptr if unknown
+    static const PanelDescriptor *findGxEPD2(int gxepd2Panel);
+};
+
+extern const PanelDescriptor PANEL_DESCRIPTORS[];
+extern const size_t PANEL_DESCRIPTOR_COUNT;
+
+// ***************************************************************************
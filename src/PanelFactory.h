@@ -5,38 +5,32 @@
 
 #pragma once
 
-#include <vector>
-#include <cstring>
-
 #include "Panel.h"
+#include "PanelDescriptor.h"
 
 // ***************************************************************************
 
+/**
+ * Creates panels from PANEL_DESCRIPTORS, only the panels asked for are
+ * instantiated
+ */
 class PanelFactory
 {
 public:
-    PanelFactory()
-    {
-        _panelPtrs.push_back(new Panel43bw());
-    }
+    PanelFactory() {}
 
     void init() { }
 
+    /// New panel instance, one per physical panel, nullptr if the name is unknown or has no native driver
     Panel *createPanel(const char *name)
     {
-        Panel *ret = nullptr;
-        for (auto const& pPanel: _panelPtrs)
+        const PanelDescriptor *descriptor = PanelDescriptor::find(name);
+        if (descriptor == nullptr || descriptor->create == nullptr)
         {
-            if (strcmp(name, pPanel->getName()) == 0)
-            {
-                ret = pPanel;
-            }
+            return nullptr;
         }
-        return ret;
+        return descriptor->create(*descriptor);
     }
-
-private:
-    std::vector<Panel*> _panelPtrs;
 };
 
 // ***************************************************************************
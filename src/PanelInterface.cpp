@@ -4,29 +4,99 @@
  */
 
 #include <Arduino.h>
-#include <SPI.h>
+#include <driver/spi_master.h>
+#ifndef PANEL_SIMULATION
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#endif
 
+#include "MemoryPlanner.h"
 #include "PanelInterface.h"
+#ifdef PANEL_SIMULATION
+#include "SimulatedController.h"
+#endif
 
 
 // ***************************************************************************
 
+bool PanelInterface::_isBusInitialized = false;
+
+/// Initialises the SPI bus once and adds the panel as a device, CS is driven by the SPI hardware
 void PanelInterface::init()
 {
     pinMode(_busy_pin, INPUT);
-    pinMode(_cs_pin, OUTPUT);
     pinMode(_dc_pin, OUTPUT);
     pinMode(_rst_pin, OUTPUT);
 
-    digitalWrite(_cs_pin, HIGH);
     digitalWrite(_dc_pin, HIGH);
     digitalWrite(_rst_pin, HIGH);
-    SPI.end();
-    SPI.begin(_sck_pin, /*unused*/_miso_pin, _mosi_pin, _cs_pin);
+#ifndef PANEL_SIMULATION
+    if (!_isBusInitialized)
+    {
+        spi_bus_config_t bus_config = {};
+        bus_config.mosi_io_num = _mosi_pin;
+        bus_config.miso_io_num = -1;    // write only, _miso_pin is unused
+        bus_config.sclk_io_num = _sck_pin;
+        bus_config.quadwp_io_num = -1;
+        bus_config.quadhd_io_num = -1;
+        bus_config.max_transfer_sz = MAX_CHUNK_SIZE;
+        const esp_err_t err = spi_bus_initialize(SPI_HOST_DEVICE, &bus_config, SPI_DMA_CHANNEL);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(__FILE__, "%s(%d): Cannot initialize the SPI bus: %s", __FILE__, __LINE__, esp_err_to_name(err));
+            return;
+        }
+        _isBusInitialized = true;
+    }
+    if (_device == nullptr)
+    {
+        addDevice();
+    }
+#endif
 };
 
+#ifndef PANEL_SIMULATION
+void PanelInterface::addDevice()
+{
+    spi_device_interface_config_t device_config = {};
+    device_config.mode = 0;
+    device_config.clock_speed_hz = _spiClock_hz;
+    device_config.spics_io_num = _cs_pin;
+    device_config.flags = SPI_DEVICE_HALFDUPLEX;
+    device_config.queue_size = TRANSACTION_SLOTS;
+    device_config.pre_cb = preTransfer;
+    const esp_err_t err = spi_bus_add_device(SPI_HOST_DEVICE, &device_config, &_device);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(__FILE__, "%s(%d): Cannot add the panel to the SPI bus: %s", __FILE__, __LINE__, esp_err_to_name(err));
+        _device = nullptr;
+    }
+}
+#endif
+
+/// The device is added again with the new clock if it exists already
+void PanelInterface::setSpiClock(int clock_hz)
+{
+    if (clock_hz == _spiClock_hz)
+        return;
+    _spiClock_hz = clock_hz;
+#ifndef PANEL_SIMULATION
+    if (_device != nullptr)
+    {
+        flushQueue();
+        spi_bus_remove_device(_device);
+        _device = nullptr;
+        addDevice();
+    }
+#endif
+}
+
 void PanelInterface::reset(uint32_t before_reset_ms, uint32_t reset_duration_ms, uint32_t after_reset_ms)
 {
+#ifdef PANEL_SIMULATION
+    _sim->reset();
+#endif
+    flushQueue();
     digitalWrite(_rst_pin, HIGH);
     delay(before_reset_ms);
     digitalWrite(_rst_pin, LOW);
@@ -39,85 +109,439 @@ void PanelInterface::reset(uint32_t before_reset_ms, uint32_t reset_duration_ms,
 
 bool PanelInterface::waitUntilNotBusy(int busy_level, uint32_t timeout_ms)
 {
+#ifdef PANEL_SIMULATION
+    // modelled busy time instead of the BUSY pin
+    const unsigned long busy_ms = _sim->waitUntilNotBusy();
+    const bool isOk = busy_ms <= timeout_ms;
+#else
+    flushQueue();
     delay(1); // add some margin to become active
-    unsigned long start_time_ms = micros();
+    const unsigned long start_time_ms = millis();
+
+    bool isOk;
+    if (_isLightSleepEnabled && timeout_ms >= MIN_LIGHT_SLEEP_MS)
+    {
+        isOk = sleepUntilNotBusy(busy_level, start_time_ms, timeout_ms);
+    } else {
+        isOk = blockUntilNotBusy(busy_level, start_time_ms, timeout_ms);
+    }
+
+    const unsigned long busy_ms = millis() - start_time_ms;
+#endif
+    PANEL_TRACE_CALL(busy(_lastCommand, busy_ms));
+    if (!isOk)
+    {
+        ESP_LOGE(__FILE__, "%s(%d): Busy Timeout after %lu ms (timeout %lu ms) on command 0x%02x",
+            __FILE__, __LINE__, busy_ms, (unsigned long) timeout_ms, _lastCommand);
+        return false;
+    }
+    recordBusyDuration(busy_ms);
+    ESP_LOGI(__FILE__, "%s(%d): Display was busy for %lu ms on command 0x%02x", __FILE__, __LINE__, busy_ms, _lastCommand);
+    return true;
+}
+
+// BUSY pin, interrupt and light sleep, not used by the simulation
+#ifndef PANEL_SIMULATION
+/// Blocks the task until the BUSY edge interrupt notifies it
+bool PanelInterface::blockUntilNotBusy(int busy_level, unsigned long start_time_ms, uint32_t timeout_ms)
+{
+    // the edge may come before the first check, the notification is kept
+    _waitingTask = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+    attachInterruptArg(digitalPinToInterrupt(_busy_pin), busyIsr, this, busy_level == LOW ? RISING : FALLING);
+
+    bool isOk = true;
     while (digitalRead(_busy_pin) == busy_level)
     {
-        delay(1);
-        if ((micros() - start_time_ms) > timeout_ms)
+        const unsigned long elapsed_ms = millis() - start_time_ms;
+        if (elapsed_ms >= timeout_ms)
+        {
+            isOk = false;
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms - elapsed_ms) + 1);
+    }
+    detachInterrupt(digitalPinToInterrupt(_busy_pin));
+    _waitingTask = nullptr;
+    return isOk;
+}
+
+/// Light sleeps until BUSY is released, restores the pins and SPI on wake
+bool PanelInterface::sleepUntilNotBusy(int busy_level, unsigned long start_time_ms, uint32_t timeout_ms)
+{
+    while (digitalRead(_busy_pin) == busy_level)
+    {
+        const unsigned long elapsed_ms = millis() - start_time_ms;
+        if (elapsed_ms >= timeout_ms)
         {
-            ESP_LOGE(__FILE__, "%s(%d): Busy Timeout after %ld ms (timeout %ld ms)", __FILE__, __LINE__, micros()-start_time_ms, timeout_ms);
             return false;
         }
+        lightSleepWhileBusy(_busy_pin, busy_level, timeout_ms - elapsed_ms);
+        restoreAfterLightSleep();
     }
-    ESP_LOGW(__FILE__, "%s(%d): Display was busy for %ld ms", __FILE__, __LINE__, micros()-start_time_ms);
     return true;
 }
 
+/// The SPI peripheral keeps its state in light sleep, only the GPIO levels are restored
+void PanelInterface::restoreAfterLightSleep()
+{
+    digitalWrite(_dc_pin, HIGH);
+    digitalWrite(_rst_pin, HIGH);
+}
+
+/**
+ * Puts the SoC into light sleep until the BUSY pin leaves busy_level, the
+ * RTC timer wakes it after timeout_ms at the latest. Digital peripherals
+ * keep their state, the wake up sources are removed again.
+ */
+void PanelInterface::lightSleepWhileBusy(int busy_pin, int busy_level, uint32_t timeout_ms)
+{
+    gpio_wakeup_enable((gpio_num_t) busy_pin, busy_level == LOW ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_timer_wakeup(timeout_ms * 1000ULL);
+    esp_light_sleep_start();
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    gpio_wakeup_disable((gpio_num_t) busy_pin);
+}
+
+void IRAM_ATTR PanelInterface::busyIsr(void *param)
+{
+    PanelInterface *self = (PanelInterface *) param;
+    BaseType_t isHigherPriorityTaskWoken = pdFALSE;
+    if (self->_waitingTask != nullptr)
+    {
+        vTaskNotifyGiveFromISR(self->_waitingTask, &isHigherPriorityTaskWoken);
+    }
+    if (isHigherPriorityTaskWoken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+void PanelInterface::recordBusyDuration(uint32_t duration_ms)
+{
+    for (int i = 0; i < _numBusyRecords; i++)
+    {
+        if (_busyRecords[i].command == _lastCommand)
+        {
+            _busyRecords[i].duration_ms = duration_ms;
+            return;
+        }
+    }
+    if (_numBusyRecords < MAX_BUSY_RECORDS)
+    {
+        _busyRecords[_numBusyRecords++] = { _lastCommand, duration_ms };
+    }
+}
+
+uint32_t PanelInterface::getBusyDuration_ms(uint8_t command) const
+{
+    for (int i = 0; i < _numBusyRecords; i++)
+    {
+        if (_busyRecords[i].command == command)
+            return _busyRecords[i].duration_ms;
+    }
+    return 0;
+}
+
 // ***************************************************************************
 
 void PanelInterface::writeCommand(uint8_t command)
 {
-    SPI.beginTransaction(_spi_settings);
-    digitalWrite(_dc_pin, LOW);
-    digitalWrite(_cs_pin, LOW);
-    SPI.transfer(command);
-    digitalWrite(_cs_pin, HIGH);
-    digitalWrite(_dc_pin, HIGH);
-    SPI.endTransaction();
+    select();
+    sendCommand(command);
+    deselect();
+}
+
+void PanelInterface::writeCommand(uint8_t command, const uint8_t* data, size_t numBytes)
+{
+    select();
+    sendCommand(command);
+    writeBytes(data, numBytes);
+    PANEL_TRACE_CALL(addBytes(numBytes));
+    deselect();
+}
+
+// ***************************************************************************
+
+bool PanelInterface::runScript(const uint8_t *script)
+{
+    bool isOk = true;
+    while (true)
+    {
+        switch (*script++) {
+        case SCRIPT_END:
+            return isOk;
+
+        case SCRIPT_CMD: {
+            const uint8_t command = script[0];
+            const uint8_t numBytes = script[1];
+            writeCommand(command, script + 2, numBytes);
+            script += 2 + numBytes;
+            break;
+        }
+
+        case SCRIPT_FILL: {
+            const uint32_t count = script[2] | script[3] << 8 | script[4] << 16 | (uint32_t) script[5] << 24;
+            writeCommand(script[0]);
+            writeData(script[1], count);
+            script += 6;
+            break;
+        }
+
+        case SCRIPT_DELAY:
+            delay(script[0] | script[1] << 8);
+            script += 2;
+            break;
+
+        case SCRIPT_WAIT_BUSY:
+            isOk = waitUntilNotBusy(script[0], script[1] | script[2] << 8) && isOk;
+            script += 3;
+            break;
+
+        default:
+            ESP_LOGE(__FILE__, "%s(%d): Unknown script opcode 0x%02x", __FILE__, __LINE__, script[-1]);
+            return false;
+        }
+    }
+}
+
+// ***************************************************************************
+
+void PanelInterface::writeData(uint8_t data, size_t repetitions)
+{
+    select();
+    fillBytes(data, repetitions);
+    PANEL_TRACE_CALL(addBytes(repetitions));
+    deselect();
+}
+
+void PanelInterface::writeData(const uint8_t* data, size_t numBytes)
+{
+    select();
+    writeBytes(data, numBytes);
+    PANEL_TRACE_CALL(addBytes(numBytes));
+    deselect();
 }
 
 // ***************************************************************************
 
-void PanelInterface::writeData(uint8_t data, int repetitions)
+void PanelInterface::startDataTransfer()
+{
+    select();
+}
+
+void PanelInterface::transferData(uint8_t value)
+{
+    writeBytes(&value, 1);
+    PANEL_TRACE_CALL(addBytes(1));
+}
+
+void PanelInterface::transferData(const uint8_t* data, size_t numBytes)
+{
+    writeBytes(data, numBytes);
+    PANEL_TRACE_CALL(addBytes(numBytes));
+}
+
+void PanelInterface::endDataTransfer()
+{
+    flushQueue();
+    deselect();
+}
+
+// ***************************************************************************
+// All controller traffic passes the following primitives, which talk to the
+// simulated controller in host builds. Trace records are written by the
+// calling task only, so bytes are counted at the public entry points.
+
+/// Starts a transaction; CS is framed by the SPI hardware per queued transaction
+void PanelInterface::select()
+{
+    PANEL_TRACE_CALL(beginTransaction());
+#ifdef PANEL_SIMULATION
+    _sim->select();
+#endif
+}
+
+/// Traced builds wait for the transmission, the duration would cover the queueing only
+void PanelInterface::deselect()
+{
+#ifdef PANEL_TRACE
+    flushQueue();
+#endif
+    PANEL_TRACE_CALL(endTransaction(_lastCommand));
+}
+
+/// Command byte with DC low, DC is high for the data bytes following it
+void PanelInterface::sendCommand(uint8_t command)
+{
+    _lastCommand = command;
+    PANEL_TRACE_CALL(command(command));
+#ifdef PANEL_SIMULATION
+    _sim->command(command);
+#else
+    Slot *slot = (Slot *) nextTransaction(-1);
+    slot->bytes[0] = command;
+    queueTransaction(&slot->trans, slot->bytes, 1, LOW);
+#endif
+}
+
+/// Copies the data into transactions of at most MAX_CHUNK_SIZE bytes
+void PanelInterface::writeBytes(const uint8_t* data, size_t numBytes)
 {
-    SPI.beginTransaction(_spi_settings);
-    digitalWrite(_cs_pin, LOW);
-    for (int i=0; i<repetitions; i++)
+#ifdef PANEL_SIMULATION
+    _sim->data(data, numBytes);
+#else
+    while (numBytes > 0)
     {
-        SPI.transfer(data);
+        const int buffer = numBytes > SLOT_SIZE ? acquireBuffer() : -1;
+        const size_t capacity = buffer >= 0 ? TRANSFER_BUFFER_SIZE : SLOT_SIZE;
+        const size_t chunkSize = numBytes < capacity ? numBytes : capacity;
+        spi_transaction_t *trans = nextTransaction(buffer);
+        uint8_t *payload = buffer >= 0 ? _buffers[buffer] : ((Slot *) trans)->bytes;
+        memcpy(payload, data, chunkSize);
+        queueTransaction(trans, payload, chunkSize, HIGH);
+        data += chunkSize;
+        numBytes -= chunkSize;
     }
-    digitalWrite(_cs_pin, HIGH);
-    SPI.endTransaction();
+#endif
 }
 
-void PanelInterface::writeData(const uint8_t* data, uint16_t numBytes)
+/// Repeats a buffer of value, e.g. to clear the controller RAM
+void PanelInterface::fillBytes(uint8_t value, size_t numBytes)
 {
-    SPI.beginTransaction(_spi_settings);
-    digitalWrite(_cs_pin, LOW);
-    for (uint16_t i = 0; i < numBytes; i++)
+#ifdef PANEL_SIMULATION
+    _sim->fill(value, numBytes);
+#else
+    const int buffer = numBytes > SLOT_SIZE ? acquireBuffer() : -1;
+    const size_t capacity = buffer >= 0 ? TRANSFER_BUFFER_SIZE : SLOT_SIZE;
+    if (buffer >= 0)
     {
-        SPI.transfer(*data++);
+        memset(_buffers[buffer], value, numBytes < capacity ? numBytes : capacity);
     }
-    digitalWrite(_cs_pin, HIGH);
-    SPI.endTransaction();
+    while (numBytes > 0)
+    {
+        const size_t chunkSize = numBytes < capacity ? numBytes : capacity;
+        spi_transaction_t *trans = nextTransaction(buffer);
+        uint8_t *payload = buffer >= 0 ? _buffers[buffer] : ((Slot *) trans)->bytes;
+        if (buffer < 0)
+        {
+            memset(payload, value, chunkSize);
+        }
+        queueTransaction(trans, payload, chunkSize, HIGH);
+        numBytes -= chunkSize;
+    }
+#endif
 }
 
 // ***************************************************************************
+// spi_master transactions, not used by the simulation
 
-void PanelInterface::startDataTransfer()
+#ifndef PANEL_SIMULATION
+/// Drives DC from the level stored with the pin in the transaction
+void IRAM_ATTR PanelInterface::preTransfer(spi_transaction_t *trans)
 {
-    SPI.beginTransaction(_spi_settings);
-    digitalWrite(_cs_pin, LOW);
+    const int dc = (int) (intptr_t) trans->user;
+    gpio_set_level((gpio_num_t) (dc >> 1), dc & 1);
 }
 
-void PanelInterface::transferData(uint8_t value)
+/// Free transaction slot, retires the oldest transaction if all are queued
+spi_transaction_t* PanelInterface::nextTransaction(int buffer)
+{
+    if (_numQueued == TRANSACTION_SLOTS)
+    {
+        retireTransaction();
+    }
+    Slot& slot = _slots[_nextSlot];
+    slot.buffer = buffer;
+    if (buffer >= 0)
+    {
+        _bufferRefs[buffer]++;
+    }
+    return &slot.trans;
+}
+
+void PanelInterface::queueTransaction(spi_transaction_t *trans, const void *data, size_t numBytes, int dc_level)
 {
-    SPI.transfer(value);
+    trans->flags = 0;
+    trans->length = numBytes * 8;
+    trans->rxlength = 0;
+    trans->tx_buffer = data;
+    trans->rx_buffer = nullptr;
+    trans->user = (void *) (intptr_t) (_dc_pin << 1 | dc_level);
+    if (_device == nullptr || spi_device_queue_trans(_device, trans, portMAX_DELAY) != ESP_OK)
+    {
+        ESP_LOGE(__FILE__, "%s(%d): Cannot queue %u bytes", __FILE__, __LINE__, (unsigned) numBytes);
+        const int buffer = ((Slot *) trans)->buffer;
+        if (buffer >= 0)
+        {
+            _bufferRefs[buffer]--;
+        }
+        return;
+    }
+    _nextSlot = (_nextSlot + 1) % TRANSACTION_SLOTS;
+    _numQueued++;
 }
 
-void PanelInterface::transferData(const uint8_t* data, uint16_t numBytes)
+/// Waits for the oldest queued transaction, transactions complete in order
+void PanelInterface::retireTransaction()
 {
-    for (uint16_t i = 0; i < numBytes; i++)
+    spi_transaction_t *trans;
+    spi_device_get_trans_result(_device, &trans, portMAX_DELAY);
+    const int buffer = ((Slot *) trans)->buffer;
+    if (buffer >= 0)
     {
-        SPI.transfer(*data++);
+        _bufferRefs[buffer]--;
     }
+    _numQueued--;
 }
 
-void PanelInterface::endDataTransfer()
+/**
+ * Next transfer buffer once its transactions are transmitted, -1 if the
+ * buffers cannot be allocated. The buffers are allocated on first use.
+ */
+int PanelInterface::acquireBuffer()
 {
-    digitalWrite(_cs_pin, HIGH);
-    SPI.endTransaction();
+    if (_buffers[0] == nullptr)
+    {
+        if (_isBufferFailed)
+            return -1;
+        for (int i = 0; i < TRANSFER_BUFFERS; i++)
+        {
+            _buffers[i] = (uint8_t *) MemoryPlanner::allocate(MemoryPlanner::TRANSFER, TRANSFER_BUFFER_SIZE);
+            if (_buffers[i] == nullptr)
+            {
+                ESP_LOGE(__FILE__, "%s(%d): Cannot allocate the transfer buffers", __FILE__, __LINE__);
+                for (int j = 0; j < i; j++)
+                {
+                    MemoryPlanner::release(MemoryPlanner::TRANSFER, _buffers[j]);
+                    _buffers[j] = nullptr;
+                }
+                _isBufferFailed = true;
+                return -1;
+            }
+        }
+    }
+    const int buffer = _nextBuffer;
+    while (_bufferRefs[buffer] > 0)
+    {
+        retireTransaction();
+    }
+    _nextBuffer = (buffer + 1) % TRANSFER_BUFFERS;
+    return buffer;
+}
+#endif
+
+void PanelInterface::flushQueue()
+{
+#ifndef PANEL_SIMULATION
+    while (_numQueued > 0)
+    {
+        retireTransaction();
+    }
+#endif
 }
 
 // ***************************************************************************
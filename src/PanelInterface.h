@@ -6,10 +6,59 @@
 #pragma once
 
 #include <Arduino.h>
-#include <SPI.h>
+#include <driver/spi_master.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifdef PANEL_TRACE
+#include "PanelTrace.h"
+#define PANEL_TRACE_CALL(call) _trace.call
+#else
+#define PANEL_TRACE_CALL(call)
+#endif
 
 // ***************************************************************************
 
+class SimulatedController;
+
+/**
+ * SPI connection to the panel controller on the ESP-IDF spi_master driver.
+ * CS is driven by the SPI hardware, DC by the pre transfer callback from
+ * the level stored in the transaction. Commands and data are queued as
+ * DMA transactions back to back, without GPIO calls or bus locking per
+ * byte, and lengths are size_t so a plane of a large panel fits into a
+ * single call.
+ *
+ * Payloads of up to SLOT_SIZE bytes (commands, LUTs) are copied into the
+ * transaction, longer ones into one of TRANSFER_BUFFERS buffers of up to
+ * MAX_CHUNK_SIZE bytes, so all write functions return as soon as the data
+ * is queued and the caller packs the next rows while the previous ones are
+ * transmitted. The queue is flushed before waiting for BUSY, before a reset
+ * and in endDataTransfer(). CS is released between transactions, which the
+ * controllers accept between any two bytes.
+ *
+ * waitUntilNotBusy() blocks the calling task until the BUSY edge interrupt
+ * notifies it, so the CPU idles during a refresh. The busy duration is
+ * recorded per command. With setLightSleep(), long waits put the SoC into
+ * light sleep until BUSY is released instead.
+ *
+ * Init, refresh and sleep sequences are byte tables run by runScript():
+ *
+ * - SCRIPT_CMD cmd n data[n]: command with n (< 256) data bytes, queued
+ *   back to back
+ * - SCRIPT_FILL cmd value count[4]: command followed by count (32 bit little
+ *   endian) repetitions of value
+ * - SCRIPT_DELAY ms[2]: delay, 16 bit little endian
+ * - SCRIPT_WAIT_BUSY level timeout_ms[2]: waitUntilNotBusy()
+ * - SCRIPT_END
+ *
+ * Host builds with -DPANEL_SIMULATION send all traffic to a
+ * SimulatedController instead of SPI, see attachSimulation().
+ *
+ * Builds with -DPANEL_TRACE record commands, transactions and busy waits in
+ * a PanelTrace, see getTrace(). Without it, PANEL_TRACE_CALL() expands to
+ * nothing.
+ */
 class PanelInterface
 {
 public:
@@ -17,26 +66,127 @@ public:
         int dc_pin, int rst_pin, int busy_pin):
         _sck_pin(sck_pin), _miso_pin(miso_pin), _mosi_pin(mosi_pin), _cs_pin(cs_pin), 
         _dc_pin(dc_pin), _rst_pin(rst_pin), _busy_pin(busy_pin), 
-        _spi_settings(4000000, MSBFIRST, SPI_MODE0)
+        _spiClock_hz(SPI_CLOCK_HZ), _device(nullptr), _slots{}, _nextSlot(0), _numQueued(0),
+        _buffers{}, _bufferRefs{}, _nextBuffer(0), _isBufferFailed(false),
+        _waitingTask(nullptr), _lastCommand(0), _busyRecords{}, _numBusyRecords(0),
+        _isLightSleepEnabled(false)
+#ifdef PANEL_SIMULATION
+        , _sim(nullptr)
+#endif
     {}
 
     void init();
+#ifdef PANEL_SIMULATION
+    void attachSimulation(SimulatedController *sim) { _sim = sim; }
+#endif
+#ifdef PANEL_TRACE
+    PanelTrace& getTrace() { return _trace; }
+#endif
+    /// SPI clock of the panel controller, SPI_CLOCK_HZ by default
+    void setSpiClock(int clock_hz);
+    int getSpiClock_hz() const { return _spiClock_hz; }
     void reset(uint32_t before_reset_ms, uint32_t reset_duration_ms, uint32_t after_reset_ms);
 
     bool waitUntilNotBusy(int busy_level, uint32_t timeout_ms);
+    /// Busy duration after the last execution of a command, 0 if unknown
+    uint32_t getBusyDuration_ms(uint8_t command) const;
+    /// Light sleep during waits of at least MIN_LIGHT_SLEEP_MS, WiFi should be off
+    void setLightSleep(bool isEnabled) { _isLightSleepEnabled = isEnabled; }
+#ifndef PANEL_SIMULATION
+    static void lightSleepWhileBusy(int busy_pin, int busy_level, uint32_t timeout_ms);
+#endif
+
+    enum ScriptOpcode: uint8_t { SCRIPT_END, SCRIPT_CMD, SCRIPT_FILL, SCRIPT_DELAY, SCRIPT_WAIT_BUSY };
+    /// Runs a panel script, false on a busy timeout or an unknown opcode
+    bool runScript(const uint8_t *script);
 
     void writeCommand(uint8_t command);
-    void writeData(uint8_t data, int repetitions = 1);
-    void writeData(const uint8_t* data, uint16_t numBytes);
+    /// Command and its data in one transaction
+    void writeCommand(uint8_t command, const uint8_t* data, size_t numBytes);
+    void writeData(uint8_t data, size_t repetitions = 1);
+    void writeData(const uint8_t* data, size_t numBytes);
 
     void startDataTransfer();
     void transferData(uint8_t value);
-    void transferData(const uint8_t* data, uint16_t numBytes);
+    void transferData(const uint8_t* data, size_t numBytes);
+    /// Waits until all queued transactions are transmitted
+    void flushQueue();
     void endDataTransfer();
 
+    /// largest single transfer, the size of an ESP32 SPI DMA descriptor
+    static const size_t MAX_CHUNK_SIZE = 4092;
+    /// payload copied into the transaction itself, covers commands and LUTs
+    static const size_t SLOT_SIZE = 64;
+    /// queue depth of the SPI device
+    static const int TRANSACTION_SLOTS = 8;
+    static const int TRANSFER_BUFFERS = 2;
+    static const size_t TRANSFER_BUFFER_SIZE = MAX_CHUNK_SIZE;
+    static const uint32_t MIN_LIGHT_SLEEP_MS = 100;
+    /// default clock, see setSpiClock()
+    static const int SPI_CLOCK_HZ = 4000000;
+    /// HSPI, VSPI stays with the Arduino SPI object
+    static const spi_host_device_t SPI_HOST_DEVICE = HSPI_HOST;
+    static const int SPI_DMA_CHANNEL = 1;
+
 private:
+    void addDevice();
+    void select();
+    void deselect();
+    void sendCommand(uint8_t command);
+    void writeBytes(const uint8_t* data, size_t numBytes);
+    void fillBytes(uint8_t value, size_t numBytes);
+    spi_transaction_t* nextTransaction(int buffer);
+    void queueTransaction(spi_transaction_t *trans, const void *data, size_t numBytes, int dc_level);
+    void retireTransaction();
+    int acquireBuffer();
+    static void preTransfer(spi_transaction_t *trans);
+#ifndef PANEL_SIMULATION
+    static void busyIsr(void *param);
+    bool blockUntilNotBusy(int busy_level, unsigned long start_time_ms, uint32_t timeout_ms);
+    bool sleepUntilNotBusy(int busy_level, unsigned long start_time_ms, uint32_t timeout_ms);
+    void restoreAfterLightSleep();
+#endif
+    void recordBusyDuration(uint32_t duration_ms);
+
+    /// Transaction with its own payload, trans is the first member
+    struct Slot
+    {
+        spi_transaction_t trans;
+        int buffer;     //< transfer buffer referenced, -1 if none
+        uint8_t bytes[SLOT_SIZE] __attribute__((aligned(4)));
+    };
+
+    struct BusyRecord
+    {
+        uint8_t command;
+        uint32_t duration_ms;
+    };
+    static const int MAX_BUSY_RECORDS = 8;
+
     int _sck_pin, _miso_pin, _mosi_pin, _cs_pin, _dc_pin, _rst_pin, _busy_pin;
-    SPISettings _spi_settings;
+    static bool _isBusInitialized;
+
+    int _spiClock_hz;
+    spi_device_handle_t _device;
+    Slot _slots[TRANSACTION_SLOTS];
+    int _nextSlot;
+    int _numQueued;             //< transactions queued, the oldest first
+    uint8_t *_buffers[TRANSFER_BUFFERS];
+    int _bufferRefs[TRANSFER_BUFFERS];  //< queued transactions per buffer
+    int _nextBuffer;
+    bool _isBufferFailed;
+
+    TaskHandle_t volatile _waitingTask;
+    uint8_t _lastCommand;
+    BusyRecord _busyRecords[MAX_BUSY_RECORDS];
+    int _numBusyRecords;
+    bool _isLightSleepEnabled;
+#ifdef PANEL_SIMULATION
+    SimulatedController *_sim;
+#endif
+#ifdef PANEL_TRACE
+    PanelTrace _trace;
+#endif
 };
 
 // ***************************************************************************
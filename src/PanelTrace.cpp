@@ -0,0 +1,92 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <Arduino.h>
+#include <esp_log.h>
+
+#include "PanelTrace.h"
+
+// ***************************************************************************
+
+void PanelTrace::clear()
+{
+    _next = 0;
+    _count = 0;
+    _transactionStart_us = 0;
+    _transactionBytes = 0;
+    _summary = {};
+}
+
+void PanelTrace::add(Type type, uint8_t command, uint32_t start_us, uint32_t duration_us, uint32_t length)
+{
+    _records[_next] = { start_us, duration_us, length, type, command, 0 };
+    _next = (_next + 1) % MAX_RECORDS;
+    if (_count < MAX_RECORDS)
+        _count++;
+}
+
+// ***************************************************************************
+
+void PanelTrace::command(uint8_t command)
+{
+    _summary.commands++;
+    add(COMMAND, command, micros(), 0, 0);
+}
+
+void PanelTrace::beginTransaction()
+{
+    _transactionStart_us = micros();
+    _transactionBytes = 0;
+}
+
+void PanelTrace::endTransaction(uint8_t command)
+{
+    const uint32_t duration_us = micros() - _transactionStart_us;
+    _summary.transactions++;
+    _summary.dataBytes += _transactionBytes;
+    _summary.transfer_us += duration_us;
+    add(TRANSACTION, command, _transactionStart_us, duration_us, _transactionBytes);
+}
+
+void PanelTrace::busy(uint8_t command, uint32_t busy_ms)
+{
+    const uint32_t start_us = micros() - busy_ms * 1000;
+    _summary.busy_ms += busy_ms;
+    if (busy_ms >= _summary.slowestBusy_ms)
+    {
+        _summary.slowestBusy_ms = busy_ms;
+        _summary.slowestCommand = command;
+    }
+    add(BUSY, command, start_us, busy_ms * 1000, 0);
+}
+
+// ***************************************************************************
+
+/// Oldest record first, 4 records per line
+void PanelTrace::dump() const
+{
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    static const int RECORDS_PER_LINE = 4;
+    char line[RECORDS_PER_LINE * sizeof(Record) * 2 + 1];
+
+    const int first = (_next - _count + MAX_RECORDS) % MAX_RECORDS;
+    for (int i = 0; i < _count; i += RECORDS_PER_LINE)
+    {
+        char *p = line;
+        for (int j = i; j < i + RECORDS_PER_LINE && j < _count; j++)
+        {
+            const uint8_t *bytes = (const uint8_t *) &_records[(first + j) % MAX_RECORDS];
+            for (size_t k = 0; k < sizeof(Record); k++)
+            {
+                *p++ = HEX_DIGITS[bytes[k] >> 4];
+                *p++ = HEX_DIGITS[bytes[k] & 0x0f];
+            }
+        }
+        *p = 0;
+        ESP_LOGI(__FILE__, "PanelTrace: %s", line);
+    }
+}
+
+// ***************************************************************************
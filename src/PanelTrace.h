@@ -0,0 +1,81 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ***************************************************************************
+
+/**
+ * Ring buffer of the panel traffic of PanelInterface, compiled in with
+ * -DPANEL_TRACE only: commands, transactions with their data length and
+ * duration, and busy waits. Records are 16 bytes, little endian:
+ *
+ *     uint32_t start_us, uint32_t duration_us, uint32_t length,
+ *     uint8_t type, uint8_t command, uint16_t reserved
+ *
+ * A transaction lasts until its bytes are transmitted: PanelInterface
+ * flushes its queue before ending a traced transaction, which serializes
+ * the traffic of traced builds.
+ *
+ * dump() logs the records as hex lines "PanelTrace: ...", which
+ * tools/panel_trace.py decodes into a timeline. The summary covers all
+ * records since clear(), including those overwritten in the ring.
+ */
+class PanelTrace
+{
+public:
+    enum Type: uint8_t { COMMAND, TRANSACTION, BUSY };
+
+    struct Record
+    {
+        uint32_t start_us;
+        uint32_t duration_us;
+        uint32_t length;
+        uint8_t type;
+        uint8_t command;
+        uint16_t reserved;
+    };
+
+    struct Summary
+    {
+        uint32_t commands;
+        uint32_t transactions;
+        uint32_t dataBytes;
+        uint32_t transfer_us;
+        uint32_t busy_ms;
+        uint32_t slowestBusy_ms;
+        uint8_t slowestCommand;
+    };
+
+    static const int MAX_RECORDS = 128;
+
+    PanelTrace() { clear(); }
+    void clear();
+
+    void command(uint8_t command);
+    void beginTransaction();
+    void addBytes(size_t numBytes) { _transactionBytes += numBytes; }
+    void endTransaction(uint8_t command);
+    /// Busy wait ending now
+    void busy(uint8_t command, uint32_t busy_ms);
+
+    const Summary& getSummary() const { return _summary; }
+    void dump() const;
+
+private:
+    void add(Type type, uint8_t command, uint32_t start_us, uint32_t duration_us, uint32_t length);
+
+    Record _records[MAX_RECORDS];
+    int _next;
+    int _count;
+    uint32_t _transactionStart_us;
+    uint32_t _transactionBytes;
+    Summary _summary;
+};
+
+// ***************************************************************************
@@ -9,16 +9,29 @@
 
 #include "lodepng.h"
 
+#include "FrameRotation.h"
+#include "MemoryPlanner.h"
 #include "PixelBuffer.h"
 
 
-PixelBuffer::PixelBuffer(int width, int height, int bitPerPixel, const Logger& parentLogger): 
+PixelBuffer::PixelBuffer(int width, int height, int bitPerPixel, int planes, const Logger& parentLogger): 
     Adafruit_GFX(width, height), 
     _width(width), 
     _height(height), 
     _bitPerPixel(bitPerPixel),
+    _planes(planes),
     _logger(__FILE__, parentLogger)
 {
+    _plane = 0;
+    _planeSize = 0;
+    _frameRotation = 0;
+    _isPanelLayout = true;
+    _bufWidth = width;
+    _bufHeight = height;
+    _bandY = 0;
+    _bandRows = 0;
+    _bandPlane = 0;
+    resetClipRect();
     _pngImagePtr = nullptr;
     _pngImageSize = 0;
     _bufPtr = nullptr;
@@ -35,9 +48,6 @@ PixelBuffer::~PixelBuffer()
 
 #include "pngle.h"
 static PixelBuffer* pixelBufferPtr;
-uint8_t selected_r;
-uint8_t selected_g;
-uint8_t selected_b;
 
 uint32_t pixels_set;
 uint32_t pixels_unset;
@@ -50,60 +60,272 @@ void on_draw(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uin
     uint8_t b = rgba[2]; // 0 - 255
     //uint8_t a = rgba[3]; // 0: fully transparent, 255: fully opaque
 
-    if (r == selected_r && g == selected_g && b == selected_b)
+    for (int plane = 0; plane < pixelBufferPtr->getPlanes(); plane++)
     {
-        pixelBufferPtr->drawPixel(x, y, 1);
-        pixels_set++;
-    } else {
-        pixelBufferPtr->drawPixel(x, y, 0);
-        pixels_unset++;
+        uint16_t value = pixelBufferPtr->getPlaneValue(plane, r, g, b);
+        pixelBufferPtr->selectPlane(plane);
+        pixelBufferPtr->drawPixel(x, y, value);
+        if (value)
+            pixels_set++;
+        else
+            pixels_unset++;
     }
+    pixelBufferPtr->selectPlane(0);
 }
 
-bool PixelBuffer::writePngChannelToBuffer(std::tuple<uint8_t, uint8_t, uint8_t> color)
+/**
+ * Value of a color in the given plane. For 1 bpp, a plane's pixel is set
+ * if the color is the plane's color; for 2 bpp, the luminance is quantized
+ * to 4 grey levels (BT.601 weights, sum 256).
+ */
+uint16_t PixelBuffer::getPlaneValue(int plane, uint8_t r, uint8_t g, uint8_t b) const
+{
+    if (_bitPerPixel == 2)
+    {
+        return (77 * r + 150 * g + 29 * b) >> 14;
+    }
+    if (plane >= (int) _planeColors.size())
+    {
+        return 0;
+    }
+    const auto& color = _planeColors[plane];
+    return r == std::get<0>(color) && g == std::get<1>(color) && b == std::get<2>(color);
+}
+
+/// Feeds the complete image to pngle
+bool PixelBuffer::feedPng(pngle_t *pngle)
+{
+    int processed_bytes = 0;
+    while (processed_bytes < _pngImageSize)
+    {
+        int fed = pngle_feed(pngle, &_pngImagePtr[processed_bytes], _pngImageSize - processed_bytes);
+        if (fed < 0)
+        {
+            _logger.error("pngle error %s", pngle_error(pngle));
+            return false;
+        }
+        processed_bytes += fed;
+        _logger.info("fed=%d processed =%d", fed, processed_bytes);
+    }
+    return true;
+}
+
+/**
+ * Decodes the PNG into all planes in a single pass using the colors set
+ * by setPlaneColors().
+ */
+bool PixelBuffer::writePngToBuffer()
 {
     // check invariants
-    if (_pngImagePtr == nullptr) {
+    if (_pngImagePtr == nullptr || _bufPtr == nullptr) {
         _logger.error("_pngImagePtr not set.");
         return false;
     }
+    if (_bitPerPixel == 1 && _planeColors.size() < _planes) {
+        _logger.error("%d colors given for %d planes", _planeColors.size(), _planes);
+        return false;
+    }
 
-    // configure on_draw
-    selected_r = std::get<0>(color);
-    selected_g = std::get<1>(color);
-    selected_b = std::get<2>(color);
-    _logger.info("Decode PNG channel r=%d g=%d b=%d", selected_r, selected_g, selected_b);
+    _logger.info("Decode PNG into %d plane(s)", _planes);
 
-    // create a white background
-    memset(_bufPtr, 0, _bufSize);
+    // decode into the logical layout, rotateToPanel() converts it
+    resetLayout();
     pixels_set = 0;
     pixels_unset = 0;
 
-    // setup pngle to draw the channel
+    // setup pngle to draw the planes
     pngle_t *pngle = pngle_new();
 
     pixelBufferPtr = this;
+    _plane = 0;
     pngle_set_draw_callback(pngle, on_draw);
 
-    // Feed data to pngle
-    int processed_bytes = 0;
-    while (processed_bytes < _pngImageSize)
+    bool isOk = feedPng(pngle);
+    pngle_destroy(pngle);
+    if (!isOk)
     {
-        int fed = pngle_feed(pngle, &_pngImagePtr[processed_bytes], _pngImageSize - processed_bytes);
-        if (fed < 0)
-        {
-            _logger.error("pngle error %s", pngle_error(pngle));
-        }
-        processed_bytes += fed;
-        _logger.info("fed=%d processed =%d", fed, processed_bytes);
+        return false;
+    }
+
+    _logger.info("PNG decoding ok - set=%d unset=%d!", pixels_set, pixels_unset);
+    return true;
+}
+
+// ***** Streaming ***********************************************************
+
+static int stream_plane;
+static const PixelBuffer::BandSink* stream_sink;
+
+void on_draw_band(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4])
+{
+    // rows arrive in order, so a pixel beyond the band completes it
+    pixelBufferPtr->flushBandsBefore(y, *stream_sink);
+    pixelBufferPtr->drawPixel(x, y, pixelBufferPtr->getPlaneValue(stream_plane, rgba[0], rgba[1], rgba[2]));
+}
+
+/**
+ * Prepares decoding the PNG band by band, see streamPng().
+ */
+bool PixelBuffer::preparePngStream(unsigned char *pngImagePtr, size_t pngImageSize, int bandRows)
+{
+    _logger.info("Streaming image (%d bytes) in bands of %d rows", pngImageSize, bandRows);
+    _pngImagePtr  = pngImagePtr;
+    _pngImageSize = pngImageSize;
+    return allocateBand(bandRows);
+}
+
+/**
+ * Only non-interlaced images deliver their rows in order. The interlace
+ * method is the last byte of the IHDR chunk, which directly follows the
+ * PNG signature.
+ */
+bool PixelBuffer::isPngStreamable() const
+{
+    return _pngImagePtr != nullptr && _pngImageSize > 28 && _pngImagePtr[28] == 0;
+}
+
+/**
+ * Decodes one plane of the PNG without a frame buffer. Every completed band
+ * is handed to the sink; the sink may still draw into the band (e.g.
+ * overlays) before transferring it. Decode once per plane (and panel pass).
+ */
+bool PixelBuffer::streamPng(int plane, const BandSink& sink)
+{
+    if (_pngImagePtr == nullptr || _bufPtr == nullptr || _bandRows == 0) {
+        _logger.error("Not prepared for streaming. Call PixelBuffer::preparePngStream first.");
+        return false;
+    }
+    if (!isPngStreamable()) {
+        _logger.error("Interlaced PNG images cannot be streamed");
+        return false;
     }
 
+    selectBand(0, plane);
+    pngle_t *pngle = pngle_new();
+    pixelBufferPtr = this;
+    stream_plane = plane;
+    stream_sink = &sink;
+    pngle_set_draw_callback(pngle, on_draw_band);
+
+    bool isOk = feedPng(pngle);
     pngle_destroy(pngle);
+    if (!isOk)
+    {
+        return false;
+    }
 
-    _logger.info("PNG decoding ok - set=%d unset=%d!", pixels_set, pixels_unset);
+    // remaining rows, including rows below a smaller image
+    flushBandsBefore(_height, sink);
+    return true;
+}
+
+/// Hands all bands ending before the given panel row to the sink
+void PixelBuffer::flushBandsBefore(int row, const BandSink& sink)
+{
+    while (_bandY < _height)
+    {
+        const int numRows = (_bandY + _bandRows < _height) ? _bandRows : _height - _bandY;
+        if (row < _bandY + numRows)
+            break;
+        sink(_bufPtr, _bandY, numRows);
+        selectBand(_bandY + _bandRows, _bandPlane);
+    }
+}
+
+/// Switches to the logical layout and clears all planes to white
+void PixelBuffer::resetLayout()
+{
+    FrameRotation::getNativeSize(_frameRotation, _width, _height, _bufWidth, _bufHeight);
+    _isPanelLayout = _frameRotation == 0;
+    clearToWhite();
+}
+
+/**
+ * Fills each plane with its value of white: set in the white plane of
+ * 1 bpp panels, cleared in the color planes, level 3 for 2 bpp. A band
+ * holds the planes from the one given to selectBand() on.
+ */
+void PixelBuffer::clearToWhite()
+{
+    const int plane = _plane;
+    for (_plane = 0; _plane < _planes; _plane++)
+    {
+        fillScreen(getPlaneValue(_bandPlane + _plane, 255, 255, 255));
+    }
+    _plane = plane;
+}
+
+/**
+ * Allocates all planes, cleared to white and in the logical layout, for
+ * drawing with the Adafruit_GFX functions. White depends on the colors
+ * given to setPlaneColors() before.
+ */
+bool PixelBuffer::allocateBuf()
+{
+    _logger.info("Memory report: largest %d B, total %d B free memory",
+       heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+       heap_caps_get_free_size(MALLOC_CAP_8BIT) );
+    // the logical layout may need more padding than the panel layout
+    _planeSize = _height * ( ( _width * _bitPerPixel + 7 ) / 8 );
+    size_t logicalSize = _bufHeight * getStride();
+    if (logicalSize > _planeSize)
+        _planeSize = logicalSize;
+    _bufSize = _planes * _planeSize;
+    _bufPtr = (uint8_t *) MemoryPlanner::allocate(MemoryPlanner::FRAME, _bufSize);
+    if (_bufPtr == nullptr)
+    {
+        _logger.error("Cannot allocate %d B for %d plane(s)", _bufSize, _planes);
+        _bufSize = 0;
+        return false;
+    }
+    resetLayout();
+    return true;
+}
+
+/**
+ * Allocates a buffer holding only numRows panel rows of each plane, for
+ * rendering a frame band by band with selectBand(). Drawing outside the
+ * selected band is clipped. Band mode works in the panel layout, use
+ * setRotation() instead of setFrameRotation() for rotated content.
+ */
+bool PixelBuffer::allocateBand(int numRows)
+{
+    if (_frameRotation != 0)
+    {
+        _logger.error("Band mode does not support the frame rotation");
+        return false;
+    }
+    if (numRows > _height)
+        numRows = _height;
+    _bandRows = numRows;
+    _bandY = 0;
+    _planeSize = numRows * getStride();
+    _bufSize = _planes * _planeSize;
+    _bufPtr = (uint8_t *) MemoryPlanner::allocate(MemoryPlanner::BAND, _bufSize);
+    if (_bufPtr == nullptr)
+    {
+        _logger.error("Cannot allocate %d B for a band of %d rows", _bufSize, numRows);
+        _bufSize = 0;
+        return false;
+    }
+    _bandPlane = 0;
+    clearToWhite();
     return true;
 }
 
+/**
+ * Moves the band to start at the given panel row and clears it to white.
+ * A band renders one channel at a time, plane tells which one for its
+ * value of white.
+ */
+void PixelBuffer::selectBand(int firstRow, int plane)
+{
+    _bandY = firstRow;
+    _bandPlane = plane;
+    if (_bufPtr)
+        clearToWhite();
+}
+
 bool PixelBuffer::prepareBufForPng(unsigned char *pngImagePtr, size_t pngImageSize)
 {
     _logger.info("Decoding image (%d bytes)", pngImageSize);
@@ -113,12 +335,11 @@ bool PixelBuffer::prepareBufForPng(unsigned char *pngImagePtr, size_t pngImageSi
     _pngImagePtr  = pngImagePtr;
     _pngImageSize = pngImageSize;
 
-    // allocate memory for channel
-    _logger.info("Memory report: largest %d B, total %d B free memory",
-       heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
-       heap_caps_get_free_size(MALLOC_CAP_8BIT) );
-    _bufSize = _height * ( ( _width + 7 ) / 8 );
-    _bufPtr = (uint8_t *) malloc(_bufSize);
+    // allocate memory for all planes
+    if (!allocateBuf())
+    {
+        return false;
+    }
 
     /*
     // prepare decoding options which are called state in lodepng
@@ -154,13 +375,80 @@ bool PixelBuffer::prepareBufForPng(unsigned char *pngImagePtr, size_t pngImageSi
     return true;
 }
 
+/**
+ * Draw and decode in a rotated (logical) orientation without per-pixel
+ * rotation. Call rotateToPanel() to convert the buffer into the panel
+ * orientation before handing it to the panel. Unlike setRotation(), the
+ * rotation is applied once to the complete frame.
+ */
+void PixelBuffer::setFrameRotation(int rotation)
+{
+    _frameRotation = rotation & 3;
+    _isPanelLayout = _frameRotation == 0;
+    setRotation(0);
+    // logical and native size are swapped for 90/270 degrees
+    FrameRotation::getNativeSize(_frameRotation, _width, _height, _bufWidth, _bufHeight);
+    Adafruit_GFX::_width = _bufWidth;
+    Adafruit_GFX::_height = _bufHeight;
+}
+
+/**
+ * Converts the buffer from the logical into the panel orientation.
+ * 180 degrees are rotated in place, 90/270 degrees into a new buffer in
+ * bands of 8x8 bit blocks.
+ */
+bool PixelBuffer::rotateToPanel()
+{
+    if (_bufPtr == nullptr) {
+        _logger.error("_bufPtr not set.");
+        return false;
+    }
+    if (_isPanelLayout)
+    {
+        return true;
+    }
+
+    unsigned long start_ms = millis();
+    if (_frameRotation == 2)
+    {
+        for (int plane = 0; plane < _planes; plane++)
+        {
+            FrameRotation::rotate180InPlace(_bufPtr + plane * _planeSize, _bufWidth, _bufHeight, _bitPerPixel);
+        }
+    } else {
+        // one plane at a time, so only a single plane is needed as scratch
+        const size_t panelPlaneSize = _height * ( ( _width * _bitPerPixel + 7 ) / 8 );
+        uint8_t *rotatedPtr = (uint8_t *) MemoryPlanner::allocate(MemoryPlanner::ROTATION, _planeSize);
+        if (rotatedPtr == nullptr)
+        {
+            _logger.error("Cannot allocate %d B for the frame rotation", _planeSize);
+            return false;
+        }
+        for (int plane = 0; plane < _planes; plane++)
+        {
+            uint8_t *planePtr = _bufPtr + plane * _planeSize;
+            FrameRotation::rotateFrame(planePtr, _bufWidth, _bufHeight, _bitPerPixel, _frameRotation, rotatedPtr);
+            // the logical layout may be larger, its padding beyond the panel rows is cleared
+            memcpy(planePtr, rotatedPtr, panelPlaneSize);
+            memset(planePtr + panelPlaneSize, 0, _planeSize - panelPlaneSize);
+        }
+        MemoryPlanner::release(MemoryPlanner::ROTATION, rotatedPtr);
+    }
+    _bufWidth = _width;
+    _bufHeight = _height;
+    _isPanelLayout = true;
+    _logger.debug("Frame rotated by %d degrees in %lu ms", 90 * _frameRotation, millis() - start_ms);
+    return true;
+}
+
 void PixelBuffer::deleteBuf()
 {
     if (_bufPtr != nullptr)
     {
-        free(_bufPtr);  // yes, the lodepng memory management is c style
+        MemoryPlanner::release(_bandRows ? MemoryPlanner::BAND : MemoryPlanner::FRAME, _bufPtr);
         _bufPtr = nullptr;
         _bufSize = 0;
+        _planeSize = 0;
     }
     if (_pngImagePtr != nullptr)
     {
@@ -170,12 +458,48 @@ void PixelBuffer::deleteBuf()
     }
 }
 
+/**
+ * 64 bit hash over all planes, used to detect frames identical to the
+ * displayed one. Processes 8 bytes per step (multiply-xorshift mixing).
+ */
+uint64_t PixelBuffer::getHash() const
+{
+    const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = prime ^ ((uint64_t) _bufWidth << 32) ^ ((uint64_t) _bufHeight << 16)
+        ^ (_bitPerPixel << 8) ^ _planes;
+    if (_bufPtr == nullptr)
+        return h;
+
+    // the pixels of each plane only, not the padding of a larger logical layout
+    const size_t numBytes = _bandRows ? _planeSize : _bufHeight * getStride();
+    for (int plane = 0; plane < _planes; plane++)
+    {
+        const uint8_t *planePtr = _bufPtr + plane * _planeSize;
+        size_t i = 0;
+        for (; i + 8 <= numBytes; i += 8)
+        {
+            uint64_t w;
+            memcpy(&w, planePtr + i, sizeof(w));
+            h = (h ^ w) * prime;
+            h ^= h >> 29;
+        }
+        for (; i < numBytes; i++)
+        {
+            h = (h ^ planePtr[i]) * prime;
+        }
+    }
+    h ^= h >> 32;
+    return h;
+}
+
 // ***** Drawing *************************************************************
 
 void PixelBuffer::drawPixel(int16_t x, int16_t y, uint16_t color) {
   if (_bufPtr)
   {
-    if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height))
+    if ((x < 0) || (y < 0) || (x >= width()) || (y >= height()))
+      return;
+    if (_isClipped && ((x < _clipX0) || (y < _clipY0) || (x >= _clipX1) || (y >= _clipY1)))
       return;
 
     int16_t t;
@@ -195,8 +519,19 @@ void PixelBuffer::drawPixel(int16_t x, int16_t y, uint16_t color) {
       y = _height - 1 - t;
       break;
     }
+    y -= _bandY;
+    if (_bandRows && ((y < 0) || (y >= _bandRows)))
+      return;
+
+    if (_bitPerPixel == 2)
+    {
+      uint8_t *ptr = &_bufPtr[_plane * _planeSize + (x / 4) + y * getStride()];
+      uint8_t shift = 6 - 2 * (x & 3);
+      *ptr = (*ptr & ~(0x03 << shift)) | ((color & 0x03) << shift);
+      return;
+    }
 
-    uint8_t *ptr = &_bufPtr[(x / 8) + y * ((WIDTH + 7) / 8)];
+    uint8_t *ptr = &_bufPtr[_plane * _planeSize + (x / 8) + y * getStride()];
     if (color)
       *ptr |= 0x80 >> (x & 7);
     else
@@ -204,6 +539,93 @@ void PixelBuffer::drawPixel(int16_t x, int16_t y, uint16_t color) {
   }
 }
 
+/**
+ * Fills the selected plane with whole bytes instead of single pixels.
+ */
+void PixelBuffer::fillScreen(uint16_t color)
+{
+    if (_bufPtr == nullptr)
+        return;
+
+    uint8_t pattern;
+    if (_bitPerPixel == 2)
+        pattern = (color & 0x03) * 0x55;
+    else
+        pattern = color ? 0xff : 0x00;
+    memset(_bufPtr + _plane * _planeSize, pattern, _planeSize);
+}
+
+/**
+ * Restricts drawing to a rectangle in drawing coordinates. fillScreen()
+ * ignores the clipping.
+ */
+void PixelBuffer::setClipRect(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+    _isClipped = true;
+    _clipX0 = x;
+    _clipY0 = y;
+    _clipX1 = x + w;
+    _clipY1 = y + h;
+}
+
+void PixelBuffer::resetClipRect()
+{
+    _isClipped = false;
+    _clipX0 = 0;
+    _clipY0 = 0;
+    _clipX1 = INT16_MAX;
+    _clipY1 = INT16_MAX;
+}
+
+/**
+ * Prints the text in the current font with the top of its bounding box at
+ * y and its left edge, center or right edge at x. Unlike setCursor(), this
+ * does not depend on the font's baseline.
+ */
+void PixelBuffer::drawText(int16_t x, int16_t y, uint16_t color, const char *text, TextAlign align)
+{
+    int16_t x1, y1;
+    uint16_t w, h;
+    setTextWrap(false);
+    setTextColor(color);
+    getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+    if (align == ALIGN_CENTER)
+        x -= w / 2;
+    else if (align == ALIGN_RIGHT)
+        x -= w;
+    setCursor(x - x1, y - y1);
+    print(text);
+}
+
+/**
+ * Composites a sprite. Unrotated buffers take the byte-wise fast path,
+ * rotated ones fall back to plotting the pixels.
+ */
+void PixelBuffer::drawSprite(int16_t x, int16_t y, const Sprite& sprite, uint16_t color)
+{
+    if (_bufPtr == nullptr)
+        return;
+
+    if (rotation == 0 && !_isClipped)
+    {
+        SpriteCompositor::draw(_bufPtr + _plane * _planeSize, _bufWidth, _bandRows ? _bandRows : _bufHeight,
+            _bitPerPixel, x, y - _bandY, sprite, color);
+        return;
+    }
+
+    const uint16_t background = _bitPerPixel == 2 ? 3 - (color & 3) : !color;
+    const int stride = sprite.getStride();
+    for (int j = 0; j < sprite.height; j++)
+    {
+        for (int i = 0; i < sprite.width; i++)
+        {
+            const uint8_t bit = 0x80 >> (i & 7);
+            if (sprite.mask[j * stride + i / 8] & bit)
+                drawPixel(x + i, y + j, (sprite.bits[j * stride + i / 8] & bit) ? color : background);
+        }
+    }
+}
+
 /**
  * Draws a battery symbol filled according to the percentage.
  * Size: 22x12
@@ -216,9 +638,7 @@ void PixelBuffer::drawBattery(int16_t x, int16_t y, uint16_t color, int voltage_
         return;
     }
 
-    drawRect(x, y, 20, 12, color);
-    fillRect(x + 20, y + 2, 2, 7, color);
-    fillRect(x + 2, y + 2, 16 * percentage / 100.0, 8, color);
+    drawSprite(x, y, StatusIcons::battery(percentage), color);
 
     //setTextColor(BLACK);
     //setTextSize(1);
@@ -238,30 +658,46 @@ void PixelBuffer::drawWiFi(int16_t x, int16_t y, uint16_t color, int rssi)
         return;
     }
 
-    int strength;
-    if (rssi > -55) {
-        strength = 5;
-    } else if (rssi < -55 && rssi > -65) {
-        strength = 4;
-    } else if (rssi < -65 && rssi > -70) {
-        strength = 3;
-    } else if (rssi < -70 && rssi > -78) {
-        strength = 2;
-    } else if (rssi < -78 && rssi > -82) {
-        strength = 1;
-    } else {
-        strength = 0;
-    }
+    drawSprite(x, y, StatusIcons::wifi(rssi), color);
+}
+
+/**
+ * Draws an hourglass marking the displayed data as outdated.
+ * Size: 12x12
+ */
+void PixelBuffer::drawStale(int16_t x, int16_t y, uint16_t color)
+{
+    drawSprite(x, y, StatusIcons::stale(), color);
+}
 
-    for (int bar = 1; bar <= 5; bar++) {
-        fillRect(x + (bar-1)*3, y+10, 2, 2, color);
-        if (bar <= strength) {
-            fillRect(x + (bar-1)*3, y + 10 - 2*bar, 2, 2*bar, color); 
+/**
+ * Draws a warning sign followed by the error code.
+ * Size: 12x12 plus 6x7 per digit
+ */
+void PixelBuffer::drawError(int16_t x, int16_t y, uint16_t color, int code)
+{
+    char text[12];
+    snprintf(text, sizeof(text), "E%d", code);
+    drawSprite(x, y, StatusIcons::error(), color);
+    drawGlyphs(x + 14, y + 3, color, text);
+}
+
+/**
+ * Draws digits, ':', '-', 'E' and ' ' using the built-in 6x7 glyphs, e.g. for
+ * a clock. The glyph cells are opaque, so a text of the same length replaces
+ * the previous one. Other characters are skipped. Returns the x position after
+ * the text.
+ */
+int16_t PixelBuffer::drawGlyphs(int16_t x, int16_t y, uint16_t color, const char *text)
+{
+    for (; *text; text++)
+    {
+        const Sprite *glyph = StatusIcons::glyph(*text);
+        if (glyph)
+        {
+            drawSprite(x, y, *glyph, color);
         }
+        x += StatusIcons::GLYPH_WIDTH;
     }
-
-    //setTextColor(BLACK);
-    //setTextSize(1);
-    //setCursor(x, y);
-    //printf("%d", rssi);
+    return x;
 }
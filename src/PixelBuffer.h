@@ -5,35 +5,99 @@
 
 #pragma once
 
+#include <functional>
 #include <tuple>
+#include <vector>
 
 #include <Adafruit_GFX.h>
 
 #include "logger.h"
+#include "Sprite.h"
 
+typedef struct _pngle_t pngle_t;
 
+
+/**
+ * Frame buffer with one plane per panel channel. Drawing functions work on
+ * the plane selected by selectPlane().
+ */
 class PixelBuffer: public Adafruit_GFX
 {
 public:
-    PixelBuffer(int width, int height, int bitPerPixel,
+    typedef std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> RgbColors;
+    enum TextAlign { ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
+    /// receives each finished band, numRows panel rows starting at firstRow
+    typedef std::function<void(const uint8_t *rows, int firstRow, int numRows)> BandSink;
+
+    PixelBuffer(int width, int height, int bitPerPixel, int planes = 1,
         const Logger& parentLogger = rootLogger);
     virtual ~PixelBuffer();
 
-    const uint8_t* getBufPtr() const { return _bufPtr; }
-    bool writePngChannelToBuffer(std::tuple<uint8_t, uint8_t, uint8_t> color);
+    const uint8_t* getBufPtr(int plane = 0) const { return _bufPtr ? _bufPtr + plane * _planeSize : nullptr; }
+    uint8_t* getBufPtr(int plane = 0) { return _bufPtr ? _bufPtr + plane * _planeSize : nullptr; }
+    size_t getBufSize() const { return _bufSize; }
+    size_t getPlaneSize() const { return _planeSize; }
+    int getPlanes() const { return _planes; }
+    int getBitsPerPixel() const { return _bitPerPixel; }
+    int getStride() const { return ( _bufWidth * _bitPerPixel + 7 ) / 8; }
+    void selectPlane(int plane) { _plane = plane; }
+    void setPlaneColors(const RgbColors& planeColors) { _planeColors = planeColors; }
+    uint16_t getPlaneValue(int plane, uint8_t r, uint8_t g, uint8_t b) const;
+    void setFrameRotation(int rotation);
+    int getFrameRotation() const { return _frameRotation; }
+    bool rotateToPanel();
+    bool allocateBuf();
+    bool allocateBand(int numRows);
+    void selectBand(int firstRow, int plane = 0);
+    void flushBandsBefore(int row, const BandSink& sink);
+    int getBandRows() const { return _bandRows; }
+    bool writePngToBuffer();
     bool prepareBufForPng(unsigned char *pngImagePtr, size_t pngImageSize);
+    bool preparePngStream(unsigned char *pngImagePtr, size_t pngImageSize, int bandRows);
+    bool isPngStreamable() const;
+    bool streamPng(int plane, const BandSink& sink);
     void deleteBuf();
 
+    uint64_t getHash() const;
+
     virtual void drawPixel(int16_t x, int16_t y, uint16_t color);
+    virtual void fillScreen(uint16_t color);
+    void setClipRect(int16_t x, int16_t y, int16_t w, int16_t h);
+    void resetClipRect();
+    void drawText(int16_t x, int16_t y, uint16_t color, const char *text, TextAlign align = ALIGN_LEFT);
+    void drawSprite(int16_t x, int16_t y, const Sprite& sprite, uint16_t color);
     void drawBattery(int16_t x, int16_t y, uint16_t color, int voltage_mV, int percentage);
     void drawWiFi(int16_t x, int16_t y, uint16_t color, int rssi);
+    void drawStale(int16_t x, int16_t y, uint16_t color);
+    void drawError(int16_t x, int16_t y, uint16_t color, int code);
+    int16_t drawGlyphs(int16_t x, int16_t y, uint16_t color, const char *text);
 
 private:
+    void resetLayout();
+    void clearToWhite();
+    bool feedPng(pngle_t *pngle);
+
     const int _width;
     const int _height;
     const int _bitPerPixel;
+    const int _planes;
     Logger _logger;
 
+    int _plane;
+    size_t _planeSize;
+    RgbColors _planeColors;
+
+    int _frameRotation;
+    bool _isPanelLayout;
+    int _bufWidth;   //< width of the buffer layout, logical before rotateToPanel()
+    int _bufHeight;
+    int _bandY;      //< first panel row held by the buffer
+    int _bandRows;   //< rows held by the buffer in band mode, 0 for a full frame
+    int _bandPlane;  //< plane (channel) rendered into the band
+
+    bool _isClipped;
+    int16_t _clipX0, _clipY0, _clipX1, _clipY1;
+
     unsigned char *_pngImagePtr;
     size_t _pngImageSize;
     uint8_t* _bufPtr;
@@ -0,0 +1,187 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include "RefreshPlanner.h"
+
+// ***************************************************************************
+
+RefreshPlanner::RefreshPlanner(const Panel& panel, bool isFastEnabled, bool isLightSleep, const Logger& parentLogger):
+    _panel(panel),
+    _isFastEnabled(isFastEnabled),
+    _isLightSleep(isLightSleep),
+    _logger(__FILE__, parentLogger)
+{
+}
+
+const char* RefreshPlanner::getModeName(Mode mode)
+{
+    static const char *names[] = { "none", "partial", "fast", "full" };
+    return names[mode];
+}
+
+// ***************************************************************************
+
+RefreshPlanner::Plan RefreshPlanner::plan(const FrameDiff& diff, const History& history, time_t now) const
+{
+    if (!diff.hasChanges())
+    {
+        Plan plan = makePlan(NONE, {}, "frame unchanged");
+        log(plan);
+        return plan;
+    }
+
+    // a single window around all changes
+    auto rects = diff.getRects();
+    int x0 = rects[0].x, y0 = rects[0].y, x1 = rects[0].x + rects[0].w, y1 = rects[0].y + rects[0].h;
+    for (const auto& r : rects)
+    {
+        x0 = r.x < x0 ? r.x : x0;
+        y0 = r.y < y0 ? r.y : y0;
+        x1 = r.x + r.w > x1 ? r.x + r.w : x1;
+        y1 = r.y + r.h > y1 ? r.y + r.h : y1;
+    }
+    const DiffRect window = { (int16_t) x0, (int16_t) y0, (int16_t) (x1 - x0), (int16_t) (y1 - y0) };
+    const float areaRatio = (float) window.getArea() / (_panel.getWidth() * _panel.getHeight());
+    const float changedRatio = diff.getChangedRatio();
+    const bool isSparse = changedRatio <= MAX_SPARSE_RATIO;
+
+    const Panel::GhostingBudget budget = _panel.getGhostingBudget();
+    Plan plan;
+    if (history.cleanRefreshTime == 0)
+    {
+        plan = makePlan(FULL, window, "no clean refresh yet");
+    }
+    else if (now - history.cleanRefreshTime >= (time_t) budget.maxAge_s)
+    {
+        plan = makePlan(FULL, window, "ghosting budget expired");
+    }
+    else if (!_panel.supportsPartialRefresh())
+    {
+        plan = selectFull(history, now, changedRatio);
+    }
+    else if (changedRatio > MAX_PARTIAL_RATIO)
+    {
+        plan = selectFull(history, now, changedRatio);
+        if (changedRatio < MIN_FULL_RATIO)
+            plan.reason = "dense change";
+    }
+    else if (areaRatio > MAX_PARTIAL_AREA && !isSparse)
+    {
+        plan = selectFull(history, now, changedRatio);
+        plan.reason = "large change";
+    }
+    else if (history.partialRefreshes >= budget.maxPartialRefreshes)
+    {
+        plan = selectFull(history, now, changedRatio);
+        plan.reason = "partial refreshes exhausted";
+    } else {
+        plan = makePlan(PARTIAL, window, areaRatio > MAX_PARTIAL_AREA ? "sparse change" : "small change");
+        plan.areaRatio = areaRatio;
+    }
+    plan.changedRatio = changedRatio;
+    log(plan);
+    return plan;
+}
+
+RefreshPlanner::Plan RefreshPlanner::planFull(const History& history, time_t now) const
+{
+    Plan plan = selectFull(history, now, 0.0f);
+    log(plan);
+    return plan;
+}
+
+/// Fast while fast refreshes are left and most pixels are kept, full otherwise
+RefreshPlanner::Plan RefreshPlanner::selectFull(const History& history, time_t now, float changedRatio) const
+{
+    const Panel::GhostingBudget budget = _panel.getGhostingBudget();
+    if (!_isFastEnabled || !_panel.supportsFastRefresh())
+    {
+        return makePlan(FULL, {}, "no fast waveform");
+    }
+    if (changedRatio >= MIN_FULL_RATIO)
+    {
+        return makePlan(FULL, {}, "most pixels changed");
+    }
+    if (history.cleanRefreshTime == 0)
+    {
+        return makePlan(FULL, {}, "no clean refresh yet");
+    }
+    if (history.fastRefreshes >= budget.maxFastRefreshes
+        || now - history.cleanRefreshTime >= (time_t) budget.maxAge_s)
+    {
+        return makePlan(FULL, {}, "ghosting budget exhausted");
+    }
+    return makePlan(FAST, {}, "within ghosting budget");
+}
+
+void RefreshPlanner::record(const Plan& plan, History& history, time_t now)
+{
+    switch (plan.mode) {
+    case PARTIAL:
+        history.partialRefreshes++;
+        break;
+    case FAST:
+        // a fast waveform drives all pixels, which clears partial ghosts
+        history.partialRefreshes = 0;
+        history.fastRefreshes++;
+        break;
+    case FULL:
+        history.partialRefreshes = 0;
+        history.fastRefreshes = 0;
+        history.cleanRefreshTime = now;
+        break;
+    default:
+        break;
+    }
+}
+
+// ***************************************************************************
+
+/// Estimates the transfer at the SPI clock and the BUSY time from the panel's nominal times
+RefreshPlanner::Plan RefreshPlanner::makePlan(Mode mode, const DiffRect& window, const char *reason) const
+{
+    const Panel::RefreshTimes times = _panel.getRefreshTimes();
+    const uint32_t planeBytes = (_panel.getWidth() + 7) / 8 * _panel.getHeight();
+
+    Plan plan = { mode, window, 0, 0, 0, reason, 0.0f, 0.0f };
+    uint32_t busy_ms = 0;
+    switch (mode) {
+    case PARTIAL:
+        plan.transferBytes = 2 * (window.w / 8) * window.h;   // old and new data RAM
+        busy_ms = times.partial_ms;
+        break;
+    case FAST:
+    case FULL:
+        for (int channel = 0; channel < _panel.getChannels(); channel++)
+        {
+            plan.transferBytes += _panel.getChannelPasses(channel) * planeBytes;
+        }
+        busy_ms = mode == FAST ? times.fast_ms : times.full_ms;
+        break;
+    default:
+        break;
+    }
+
+    const uint32_t transfer_ms = (uint64_t) plan.transferBytes * 8 * 1000 / _panel.getSpiClock_hz();
+    const uint32_t waiting_mW = _isLightSleep ? MCU_LIGHT_SLEEP_MW : MCU_WAITING_MW;
+    plan.estimated_ms = transfer_ms + busy_ms;
+    plan.estimated_mJ = (transfer_ms * MCU_ACTIVE_MW + busy_ms * (PANEL_REFRESH_MW + waiting_mW)) / 1000;
+    return plan;
+}
+
+void RefreshPlanner::log(const Plan& plan) const
+{
+    if (plan.mode == PARTIAL)
+    {
+        _logger.info("Refresh plan: partial %dx%d at %d,%d (%s), area %.1f%%, changed %.1f%%, ~%u ms, ~%u mJ",
+            plan.window.w, plan.window.h, plan.window.x, plan.window.y, plan.reason,
+            plan.areaRatio * 100, plan.changedRatio * 100, plan.estimated_ms, plan.estimated_mJ);
+    } else {
+        _logger.info("Refresh plan: %s (%s), changed %.1f%%, ~%u ms, ~%u mJ",
+            getModeName(plan.mode), plan.reason, plan.changedRatio * 100, plan.estimated_ms, plan.estimated_mJ);
+    }
+}
+
+// ***************************************************************************
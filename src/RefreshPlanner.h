@@ -0,0 +1,100 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include "logger.h"
+#include "FrameDiff.h"
+#include "Panel.h"
+
+// ***************************************************************************
+
+/**
+ * Chooses the cheapest refresh which keeps the image acceptable, from
+ * the comparison with the displayed frame and the refresh history of the
+ * panel since its last clean (full, slow) refresh:
+ *
+ * - NONE: no pixel changed
+ * - FULL: no clean refresh is recorded (e.g. after power on), or the
+ *   ghosting budget of the panel (Panel::GhostingBudget) is exhausted by age
+ * - PARTIAL: partial refreshes are left, at most MAX_PARTIAL_RATIO of the
+ *   pixels changed and the window around all changes covers at most
+ *   MAX_PARTIAL_AREA of the panel. A sparse change of at most
+ *   MAX_SPARSE_RATIO of the pixels, e.g. a clock and an icon in opposite
+ *   corners, is refreshed partially in a larger window: the partial
+ *   waveform drives the changed pixels only.
+ * - FAST: fast refreshes are left and enabled, and less than
+ *   MIN_FULL_RATIO of the pixels changed
+ * - FULL otherwise, which renews the budget
+ *
+ * Each plan is logged with the window and changed pixel ratios and its
+ * estimated time (transfer and BUSY) and energy. The history is kept by the caller, usually in RTC memory, and
+ * updated by record() once the plan is executed.
+ */
+class RefreshPlanner
+{
+public:
+    enum Mode: uint8_t { NONE, PARTIAL, FAST, FULL };
+
+    struct History
+    {
+        uint8_t partialRefreshes;   //< since the last fast or full refresh
+        uint8_t fastRefreshes;      //< since the last full refresh
+        time_t cleanRefreshTime;    //< of the last full refresh, 0 for none (zeroed RTC memory)
+    };
+
+    struct Plan
+    {
+        Mode mode;
+        DiffRect window;            //< PARTIAL only
+        uint32_t transferBytes;
+        uint32_t estimated_ms;
+        uint32_t estimated_mJ;
+        const char *reason;
+        float areaRatio;            //< window area relative to the panel, PARTIAL only
+        float changedRatio;         //< changed pixels, see FrameDiff::getChangedRatio()
+    };
+
+    /// largest share of the panel refreshed partially
+    static constexpr float MAX_PARTIAL_AREA = 0.25f;
+    /// most changed pixels refreshed partially, denser changes ghost
+    static constexpr float MAX_PARTIAL_RATIO = 0.10f;
+    /// changes up to this ratio are refreshed partially regardless of their window
+    static constexpr float MAX_SPARSE_RATIO = 0.02f;
+    /// from this ratio on, a full refresh is used instead of a fast one
+    static constexpr float MIN_FULL_RATIO = 0.50f;
+
+    // power estimates at 3.3 V
+    static const uint32_t PANEL_REFRESH_MW = 20;    //< panel during a waveform, ~6 mA
+    static const uint32_t MCU_ACTIVE_MW = 100;      //< CPU at 80 MHz, WiFi off
+    static const uint32_t MCU_WAITING_MW = 60;      //< blocked on BUSY
+    static const uint32_t MCU_LIGHT_SLEEP_MW = 3;
+
+    RefreshPlanner(const Panel& panel, bool isFastEnabled, bool isLightSleep, const Logger& parentLogger = rootLogger);
+
+    /// Refresh of the changes found by diff, all planes compared
+    Plan plan(const FrameDiff& diff, const History& history, time_t now) const;
+    /// Refresh of a frame without a previous one to compare with: fast or full
+    Plan planFull(const History& history, time_t now) const;
+    /// Updates the history after plan was executed
+    static void record(const Plan& plan, History& history, time_t now);
+
+    static const char* getModeName(Mode mode);
+
+private:
+    Plan selectFull(const History& history, time_t now, float changedRatio) const;
+    Plan makePlan(Mode mode, const DiffRect& window, const char *reason) const;
+    void log(const Plan& plan) const;
+
+    const Panel& _panel;
+    const bool _isFastEnabled;
+    const bool _isLightSleep;
+    Logger _logger;
+};
+
+// ***************************************************************************
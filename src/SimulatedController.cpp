@@ -0,0 +1,286 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SimulatedController.h"
+
+// ***************************************************************************
+
+SimulatedController::SimulatedController(int width, int height):
+    _width(0),
+    _height(0),
+    _stride(0),
+    _powerOn_ms(80),
+    _powerOff_ms(20),
+    _refresh_ms(4000),
+    _partialRefresh_ms(600),
+    _stats()
+{
+    resize(width, height);
+    _display.assign(_newRam.size(), 0xff);
+    reset();
+}
+
+void SimulatedController::setBusyModel(uint32_t powerOn_ms, uint32_t powerOff_ms, uint32_t refresh_ms, uint32_t partialRefresh_ms)
+{
+    _powerOn_ms = powerOn_ms;
+    _powerOff_ms = powerOff_ms;
+    _refresh_ms = refresh_ms;
+    _partialRefresh_ms = partialRefresh_ms;
+}
+
+/// Hardware reset: registers and modes are cleared, RAM and display are kept
+void SimulatedController::reset()
+{
+    _registers.clear();
+    _command = 0;
+    _isSleeping = false;
+    _isPartial = false;
+    _busy_ms = 0;
+    _x0 = 0;
+    _x1 = _stride - 1;
+    _y0 = 0;
+    _y1 = _height - 1;
+    _x = _x0;
+    _y = _y0;
+}
+
+/// The RAM keeps its content when the resolution is set again unchanged, e.g. by an init script
+void SimulatedController::resize(int width, int height)
+{
+    if (width == _width && height == _height)
+        return;
+    _width = width;
+    _height = height;
+    _stride = (width + 7) / 8;
+    _oldRam.assign(_stride * height, 0xff);
+    _newRam.assign(_stride * height, 0xff);
+    if (_display.size() != _newRam.size())
+    {
+        _display.assign(_newRam.size(), 0xff);
+    }
+}
+
+// ***************************************************************************
+
+void SimulatedController::select()
+{
+    _stats.transactions++;
+}
+
+void SimulatedController::command(uint8_t command)
+{
+    if (_isSleeping)
+    {
+        _stats.ignoredBytes++;
+        return;
+    }
+    _stats.commandBytes++;
+    _command = command;
+    _registers[command].clear();
+
+    switch (command) {
+    case 0x02: // power off
+        _busy_ms = _powerOff_ms;
+        break;
+    case 0x04: // power on
+        _busy_ms = _powerOn_ms;
+        break;
+    case 0x10: // old data RAM
+    case 0x13: // new data RAM
+        _x = _isPartial ? _x0 : 0;
+        _y = _isPartial ? _y0 : 0;
+        break;
+    case 0x12:
+        refresh();
+        break;
+    case 0x91: // partial in
+        _isPartial = true;
+        break;
+    case 0x92: // partial out
+        _isPartial = false;
+        _x0 = 0;
+        _x1 = _stride - 1;
+        _y0 = 0;
+        _y1 = _height - 1;
+        break;
+    default:
+        break;
+    }
+}
+
+void SimulatedController::data(const uint8_t *data, size_t numBytes)
+{
+    if (_isSleeping)
+    {
+        _stats.ignoredBytes += numBytes;
+        return;
+    }
+    _stats.dataBytes += numBytes;
+
+    std::vector<uint8_t>& reg = _registers[_command];
+    reg.insert(reg.end(), data, data + numBytes);
+    if (_command == 0x10 || _command == 0x13)
+    {
+        for (size_t i = 0; i < numBytes; i++)
+            writeRam(data[i]);
+        return;
+    }
+
+    switch (_command) {
+    case 0x07: // deep sleep with check code
+        if (reg.size() == 1 && reg[0] == 0xa5)
+            _isSleeping = true;
+        break;
+    case 0x61: // resolution
+        if (reg.size() == 4)
+            resize((reg[0] << 8 | reg[1]) & 0x3f8, (reg[2] << 8 | reg[3]) & 0x3ff);
+        break;
+    case 0x90: // partial window
+        if (reg.size() == 9)
+            setPartialWindow(reg);
+        break;
+    default:
+        break;
+    }
+}
+
+void SimulatedController::fill(uint8_t value, size_t numBytes)
+{
+    std::vector<uint8_t> bytes(numBytes, value);
+    data(bytes.data(), bytes.size());
+}
+
+uint32_t SimulatedController::waitUntilNotBusy()
+{
+    const uint32_t busy_ms = _busy_ms;
+    _stats.busy_ms += busy_ms;
+    _busy_ms = 0;
+    return busy_ms;
+}
+
+// ***************************************************************************
+
+/// HRST[8:3], HRED[8:3], VRST[8:0], VRED[8:0], PT_SCAN
+void SimulatedController::setPartialWindow(const std::vector<uint8_t>& reg)
+{
+    const int hrst = (reg[0] << 8 | reg[1]) & 0x3f8;
+    const int hred = (reg[2] << 8 | reg[3]) & 0x3f8;
+    const int vrst = (reg[4] << 8 | reg[5]) & 0x3ff;
+    const int vred = (reg[6] << 8 | reg[7]) & 0x3ff;
+    _x0 = hrst / 8;
+    _x1 = hred / 8 < _stride ? hred / 8 : _stride - 1;
+    _y0 = vrst;
+    _y1 = vred < _height ? vred : _height - 1;
+}
+
+/// Writes within the window if the partial mode is on, the whole RAM otherwise
+void SimulatedController::writeRam(uint8_t value)
+{
+    const bool isWindow = _isPartial;
+    const int x0 = isWindow ? _x0 : 0;
+    const int x1 = isWindow ? _x1 : _stride - 1;
+    const int y1 = isWindow ? _y1 : _height - 1;
+    if (_y > y1)
+    {
+        _stats.ignoredBytes++;
+        return;
+    }
+
+    std::vector<uint8_t>& ram = _command == 0x10 ? _oldRam : _newRam;
+    ram[_y * _stride + _x] = value;
+    if (++_x > x1)
+    {
+        _x = x0;
+        _y++;
+    }
+}
+
+void SimulatedController::refresh()
+{
+    const uint32_t lut_ms = getLutDuration_ms();
+    if (_isPartial)
+    {
+        for (int y = _y0; y <= _y1; y++)
+        {
+            memcpy(&_display[y * _stride + _x0], &_newRam[y * _stride + _x0], _x1 - _x0 + 1);
+        }
+        _stats.partialRefreshes++;
+        _busy_ms = lut_ms > 0 ? lut_ms : _partialRefresh_ms;
+    } else {
+        _display = _newRam;
+        _stats.refreshes++;
+        _busy_ms = lut_ms > 0 ? lut_ms : _refresh_ms;
+    }
+}
+
+/// Frames of the VCOM LUT (0x20) at 50 Hz: groups of level select, 4 phases and repeat count
+uint32_t SimulatedController::getLutDuration_ms()
+{
+    const std::vector<uint8_t>& lut = _registers[0x20];
+    uint32_t frames = 0;
+    for (size_t i = 0; i + 6 <= lut.size(); i += 6)
+    {
+        frames += (lut[i + 1] + lut[i + 2] + lut[i + 3] + lut[i + 4]) * lut[i + 5];
+    }
+    return frames * 20;
+}
+
+// ***************************************************************************
+
+void SimulatedController::logStats() const
+{
+    printf("SimulatedController: %u transactions, %u command bytes, %u data bytes, %u ignored bytes, "
+        "%u refreshes, %u partial refreshes, busy %u ms\n",
+        _stats.transactions, _stats.commandBytes, _stats.dataBytes, _stats.ignoredBytes,
+        _stats.refreshes, _stats.partialRefreshes, _stats.busy_ms);
+}
+
+/// Binary PBM, 1 = black
+bool SimulatedController::writePbm(const char *path) const
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "P4\n%d %d\n", _width, _height);
+    std::vector<uint8_t> row(_stride);
+    bool isOk = true;
+    for (int y = 0; y < _height && isOk; y++)
+    {
+        for (int i = 0; i < _stride; i++)
+            row[i] = ~_display[y * _stride + i];
+        isOk = fwrite(row.data(), 1, _stride, file) == (size_t) _stride;
+    }
+    fclose(file);
+    return isOk;
+}
+
+/// Binary PGM of the RAM planes as in greyscale mode: old data is the high bit
+bool SimulatedController::writePgm(const char *path) const
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "P5\n%d %d\n255\n", _width, _height);
+    std::vector<uint8_t> row(_width);
+    bool isOk = true;
+    for (int y = 0; y < _height && isOk; y++)
+    {
+        for (int x = 0; x < _width; x++)
+        {
+            const int i = y * _stride + x / 8;
+            const uint8_t bit = 0x80 >> (x & 7);
+            const int level = ((_oldRam[i] & bit) ? 2 : 0) | ((_newRam[i] & bit) ? 1 : 0);
+            row[x] = level * 85;
+        }
+        isOk = fwrite(row.data(), 1, _width, file) == (size_t) _width;
+    }
+    fclose(file);
+    return isOk;
+}
+
+// ***************************************************************************
@@ -0,0 +1,105 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+// ***************************************************************************
+
+/**
+ * Model of a UC8176/UC8179/IL0398 class controller as used by PanelUC81xx, the
+ * transport of PanelInterface in host builds with -DPANEL_SIMULATION.
+ *
+ * - all commands store their data as register content (0x00-0x24 etc.),
+ *   0x10/0x13 as sent, so other RAM formats (4 bpp) can be checked, too
+ * - 0x10/0x13 write the old/new 1 bpp data RAM, within the partial window
+ *   (0x90) while the partial mode (0x91/0x92) is on
+ * - 0x61 sets the resolution and resizes the RAM if the size changes
+ * - 0x12 copies the new data RAM (or its window) to the display and
+ *   models the BUSY duration from the frames of the VCOM LUT (0x20) at
+ *   50 Hz, or from the busy model without LUT, as do power on (0x04) and
+ *   off (0x02)
+ * - after deep sleep (0x07 0xa5) everything is ignored until reset()
+ *
+ * Transactions (CS frames), command and data bytes are counted, so driver
+ * changes can be checked for transfer volume, and the display is written
+ * as PBM, the RAM planes as 4 level PGM (greyscale mode).
+ */
+class SimulatedController
+{
+public:
+    struct Stats
+    {
+        uint32_t transactions;
+        uint32_t commandBytes;
+        uint32_t dataBytes;
+        uint32_t ignoredBytes;  //< while in deep sleep
+        uint32_t refreshes;
+        uint32_t partialRefreshes;
+        uint32_t busy_ms;
+    };
+
+    SimulatedController(int width = 400, int height = 300);
+
+    void reset();
+    void select();
+    void command(uint8_t command);
+    void data(const uint8_t *data, size_t numBytes);
+    void fill(uint8_t value, size_t numBytes);
+    /// Modelled BUSY duration of the last command, 0 if not busy
+    uint32_t waitUntilNotBusy();
+
+    void setBusyModel(uint32_t powerOn_ms, uint32_t powerOff_ms, uint32_t refresh_ms, uint32_t partialRefresh_ms);
+
+    int getWidth() const { return _width; }
+    int getHeight() const { return _height; }
+    bool isSleeping() const { return _isSleeping; }
+    const std::vector<uint8_t>& getRegister(uint8_t command) { return _registers[command]; }
+    const std::vector<uint8_t>& getOldRam() const { return _oldRam; }
+    const std::vector<uint8_t>& getNewRam() const { return _newRam; }
+    /// Displayed image, 1 bit per pixel, 1 = white
+    const std::vector<uint8_t>& getDisplay() const { return _display; }
+
+    const Stats& getStats() const { return _stats; }
+    void resetStats() { _stats = {}; }
+    void logStats() const;
+
+    bool writePbm(const char *path) const;
+    bool writePgm(const char *path) const;
+
+private:
+    void resize(int width, int height);
+    void setPartialWindow(const std::vector<uint8_t>& reg);
+    void writeRam(uint8_t value);
+    void refresh();
+    uint32_t getLutDuration_ms();
+
+    int _width;
+    int _height;
+    int _stride;
+    std::vector<uint8_t> _oldRam;
+    std::vector<uint8_t> _newRam;
+    std::vector<uint8_t> _display;
+    std::map<uint8_t, std::vector<uint8_t>> _registers;
+
+    uint8_t _command;
+    bool _isSleeping;
+    bool _isPartial;
+    int _x0, _x1, _y0, _y1;   //< RAM window, x in bytes, inclusive
+    int _x, _y;               //< RAM write position
+
+    uint32_t _powerOn_ms;
+    uint32_t _powerOff_ms;
+    uint32_t _refresh_ms;
+    uint32_t _partialRefresh_ms;
+    uint32_t _busy_ms;
+    Stats _stats;
+};
+
+// ***************************************************************************
@@ -0,0 +1,267 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <string.h>
+
+#include "BitOps.h"
+#include "Sprite.h"
+
+// ***************************************************************************
+
+void SpriteCompositor::draw(uint8_t *buf, int bufWidth, int bufHeight, int bitsPerPixel,
+    int x, int y, const Sprite& sprite, uint16_t color)
+{
+    if (buf == nullptr || (bitsPerPixel != 1 && bitsPerPixel != 2))
+        return;
+
+    const int stride = (bufWidth * bitsPerPixel + 7) / 8;
+    const int srcStride = sprite.getStride();
+    const int srcBits = 8 * bitsPerPixel;   // target bits covered by one sprite byte
+    const int bitPos = x * bitsPerPixel;    // bit position of the left edge within a row
+    const int col = bitPos >> 3;            // floor, also for negative x
+    const int align = 24 - srcBits - (bitPos & 7);
+
+    uint32_t fg, bg;
+    if (bitsPerPixel == 1)
+    {
+        fg = color ? 0xff : 0x00;
+        bg = fg ^ 0xff;
+    } else {
+        fg = (color & 0x03) * 0x5555;
+        bg = (0x03 - (color & 0x03)) * 0x5555;
+    }
+
+    for (int row = 0; row < sprite.height; row++)
+    {
+        const int ty = y + row;
+        if (ty < 0 || ty >= bufHeight)
+            continue;
+        uint8_t *dstRow = buf + ty * stride;
+        const uint8_t *bits = sprite.bits + row * srcStride;
+        const uint8_t *mask = sprite.mask + row * srcStride;
+
+        for (int i = 0; i < srcStride; i++)
+        {
+            uint32_t m = mask[i];
+            uint32_t b = bits[i];
+            if (m == 0)
+                continue;
+            if (bitsPerPixel == 2)
+            {
+                m = BitOps::spreadBits(m);
+                b = BitOps::spreadBits(b);
+            }
+            uint32_t v = ((b & fg) | (~b & bg)) & m;
+
+            // place the sprite byte into a 24 bit window of 3 target bytes
+            m <<= align;
+            v <<= align;
+            const int dst = col + i * bitsPerPixel;
+            for (int k = 0; k < 3; k++)
+            {
+                const uint8_t mb = m >> (16 - 8 * k);
+                const int idx = dst + k;
+                if (mb == 0 || idx < 0 || idx >= stride)
+                    continue;
+                dstRow[idx] = (dstRow[idx] & ~mb) | (uint8_t)(v >> (16 - 8 * k));
+            }
+        }
+    }
+}
+
+// ***** Icon cache **********************************************************
+
+/// Sets a rectangle in a packed 1 bpp bitmap, used to build cached icons
+static void setBits(uint8_t *bits, int stride, int x, int y, int w, int h)
+{
+    for (int j = y; j < y + h; j++)
+        for (int i = x; i < x + w; i++)
+            bits[j * stride + i / 8] |= 0x80 >> (i & 7);
+}
+
+/**
+ * Battery symbol filled according to the percentage.
+ * Size: 22x12
+ */
+const Sprite& StatusIcons::battery(int percentage)
+{
+    const int stride = (BATTERY_WIDTH + 7) / 8;
+    static uint8_t bits[stride * ICON_HEIGHT];
+    static const Sprite sprite = { BATTERY_WIDTH, ICON_HEIGHT, bits, bits };
+    static int cachedFill = -1;
+
+    if (percentage < 0) percentage = 0;
+    if (percentage > 100) percentage = 100;
+    int fill = 16 * percentage / 100;
+    if (fill != cachedFill)
+    {
+        memset(bits, 0, sizeof(bits));
+        setBits(bits, stride, 0, 0, 20, 1);     // outline
+        setBits(bits, stride, 0, 11, 20, 1);
+        setBits(bits, stride, 0, 0, 1, 12);
+        setBits(bits, stride, 19, 0, 1, 12);
+        setBits(bits, stride, 20, 2, 2, 7);     // terminal
+        setBits(bits, stride, 2, 2, fill, 8);   // charge
+        cachedFill = fill;
+    }
+    return sprite;
+}
+
+static int wifiStrength(int rssi)
+{
+    if (rssi > -55) {
+        return 5;
+    } else if (rssi < -55 && rssi > -65) {
+        return 4;
+    } else if (rssi < -65 && rssi > -70) {
+        return 3;
+    } else if (rssi < -70 && rssi > -78) {
+        return 2;
+    } else if (rssi < -78 && rssi > -82) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Signal strength indicator using up to 5 bars.
+ * Size: 14x12
+ */
+const Sprite& StatusIcons::wifi(int rssi)
+{
+    const int stride = (WIFI_WIDTH + 7) / 8;
+    static uint8_t bits[stride * ICON_HEIGHT];
+    static const Sprite sprite = { WIFI_WIDTH, ICON_HEIGHT, bits, bits };
+    static int cachedStrength = -1;
+
+    int strength = wifiStrength(rssi);
+    if (strength != cachedStrength)
+    {
+        memset(bits, 0, sizeof(bits));
+        for (int bar = 1; bar <= 5; bar++) {
+            setBits(bits, stride, (bar-1)*3, 10, 2, 2);
+            if (bar <= strength) {
+                setBits(bits, stride, (bar-1)*3, 10 - 2*bar, 2, 2*bar);
+            }
+        }
+        cachedStrength = strength;
+    }
+    return sprite;
+}
+
+// ***** Flash icons *********************************************************
+
+static const uint8_t STALE_BITS[] = {
+    0x3f, 0xc0,  // ..########..
+    0x3f, 0xc0,  // ..########..
+    0x10, 0x80,  // ...#....#...
+    0x19, 0x80,  // ...##..##...
+    0x0f, 0x00,  // ....####....
+    0x06, 0x00,  // .....##.....
+    0x06, 0x00,  // .....##.....
+    0x09, 0x00,  // ....#..#....
+    0x10, 0x80,  // ...#....#...
+    0x16, 0x80,  // ...#.##.#...
+    0x3f, 0xc0,  // ..########..
+    0x3f, 0xc0,  // ..########..
+};
+static const uint8_t STALE_MASK[] = {
+    0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0,
+    0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0, 0xff, 0xf0,
+};
+
+static const uint8_t ERROR_BITS[] = {
+    0x06, 0x00,  // .....##.....
+    0x09, 0x00,  // ....#..#....
+    0x09, 0x00,  // ....#..#....
+    0x16, 0x80,  // ...#.##.#...
+    0x16, 0x80,  // ...#.##.#...
+    0x26, 0x40,  // ..#..##..#..
+    0x26, 0x40,  // ..#..##..#..
+    0x46, 0x20,  // .#...##...#.
+    0x40, 0x20,  // .#........#.
+    0x86, 0x10,  // #....##....#
+    0x86, 0x10,  // #....##....#
+    0xff, 0xf0,  // ############
+};
+static const uint8_t ERROR_MASK[] = {
+    0x06, 0x00,  // .....##.....
+    0x0f, 0x00,  // ....####....
+    0x0f, 0x00,  // ....####....
+    0x1f, 0x80,  // ...######...
+    0x1f, 0x80,  // ...######...
+    0x3f, 0xc0,  // ..########..
+    0x3f, 0xc0,  // ..########..
+    0x7f, 0xe0,  // .##########.
+    0x7f, 0xe0,  // .##########.
+    0xff, 0xf0,  // ############
+    0xff, 0xf0,  // ############
+    0xff, 0xf0,  // ############
+};
+
+/**
+ * Hourglass marking data which could not be refreshed.
+ * Size: 12x12
+ */
+const Sprite& StatusIcons::stale()
+{
+    static const Sprite sprite = { 12, ICON_HEIGHT, STALE_BITS, STALE_MASK };
+    return sprite;
+}
+
+/**
+ * Warning sign for error conditions.
+ * Size: 12x12
+ */
+const Sprite& StatusIcons::error()
+{
+    static const Sprite sprite = { 12, ICON_HEIGHT, ERROR_BITS, ERROR_MASK };
+    return sprite;
+}
+
+// ***** Glyphs **************************************************************
+
+static const char GLYPH_CHARS[] = "0123456789:-E ";
+
+static const uint8_t GLYPH_BITS[][StatusIcons::GLYPH_HEIGHT] = {
+    { 0x70, 0x88, 0x98, 0xa8, 0xc8, 0x88, 0x70 },  // '0'
+    { 0x20, 0x60, 0x20, 0x20, 0x20, 0x20, 0x70 },  // '1'
+    { 0x70, 0x88, 0x08, 0x10, 0x20, 0x40, 0xf8 },  // '2'
+    { 0xf8, 0x10, 0x20, 0x10, 0x08, 0x88, 0x70 },  // '3'
+    { 0x10, 0x30, 0x50, 0x90, 0xf8, 0x10, 0x10 },  // '4'
+    { 0xf8, 0x80, 0xf0, 0x08, 0x08, 0x88, 0x70 },  // '5'
+    { 0x30, 0x40, 0x80, 0xf0, 0x88, 0x88, 0x70 },  // '6'
+    { 0xf8, 0x08, 0x10, 0x20, 0x40, 0x40, 0x40 },  // '7'
+    { 0x70, 0x88, 0x88, 0x70, 0x88, 0x88, 0x70 },  // '8'
+    { 0x70, 0x88, 0x88, 0x78, 0x08, 0x10, 0x60 },  // '9'
+    { 0x00, 0x20, 0x20, 0x00, 0x20, 0x20, 0x00 },  // ':'
+    { 0x00, 0x00, 0x00, 0xf8, 0x00, 0x00, 0x00 },  // '-'
+    { 0xf8, 0x80, 0x80, 0xf0, 0x80, 0x80, 0xf8 },  // 'E'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // ' ' erases the cell
+};
+
+// glyph cells are opaque including the spacing column
+static const uint8_t GLYPH_MASK[StatusIcons::GLYPH_HEIGHT] = {
+    0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc
+};
+
+const Sprite* StatusIcons::glyph(char c)
+{
+    static Sprite glyphs[sizeof(GLYPH_CHARS) - 1];
+    static bool initialized = false;
+    if (!initialized)
+    {
+        for (size_t i = 0; i < sizeof(glyphs) / sizeof(glyphs[0]); i++)
+        {
+            glyphs[i] = { GLYPH_WIDTH, GLYPH_HEIGHT, GLYPH_BITS[i], GLYPH_MASK };
+        }
+        initialized = true;
+    }
+
+    const char *pos = c ? strchr(GLYPH_CHARS, c) : nullptr;
+    return pos ? &glyphs[pos - GLYPH_CHARS] : nullptr;
+}
+
+// ***************************************************************************
@@ -0,0 +1,68 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// ***************************************************************************
+
+/**
+ * Packed 1 bpp bitmap with a transparency mask. Rows are padded to full
+ * bytes, pixels are stored MSB first. Pixels with a 0 mask bit leave the
+ * target untouched, pixels with a 1 mask bit are set to the foreground
+ * color (bit 1) or the background color (bit 0).
+ */
+struct Sprite
+{
+    uint8_t width;
+    uint8_t height;
+    const uint8_t *bits;
+    const uint8_t *mask;
+
+    int getStride() const { return (width + 7) / 8; }
+};
+
+// ***************************************************************************
+
+class SpriteCompositor
+{
+public:
+    /**
+     * Composites the sprite into a 1 or 2 bpp plane of bufWidth x bufHeight
+     * pixels at (x, y), clipped to the plane. Works on whole bytes using
+     * shifted OR/AND-NOT operations instead of plotting single pixels.
+     * The background color is the inverse of the foreground color.
+     */
+    static void draw(uint8_t *buf, int bufWidth, int bufHeight, int bitsPerPixel,
+        int x, int y, const Sprite& sprite, uint16_t color);
+};
+
+// ***************************************************************************
+
+/**
+ * Status indicators. Static icons live in flash, icons depending on a value
+ * are built into a small cache on first use and rebuilt only if the value
+ * changes.
+ */
+class StatusIcons
+{
+public:
+    static const int BATTERY_WIDTH = 22;
+    static const int WIFI_WIDTH = 14;
+    static const int ICON_HEIGHT = 12;
+    static const int GLYPH_WIDTH = 6;
+    static const int GLYPH_HEIGHT = 7;
+
+    static const Sprite& battery(int percentage);
+    static const Sprite& wifi(int rssi);
+    static const Sprite& stale();
+    static const Sprite& error();
+
+    /// Glyph for a digit, ':', '-', 'E' or ' ' (for clocks and error codes) or nullptr
+    static const Sprite* glyph(char c);
+};
+
+// ***************************************************************************
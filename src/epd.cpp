@@ -5,107 +5,81 @@
 
 #include <Arduino.h>
 
-#include <SPI.h>
-#include <Wire.h>
 #include <esp_log.h>
 
-// specific display drivers for 4.2" 400x300 bw and 7.5" 880x528 red/black/white
-#include <epd/GxEPD2_420.h>
-#include <epd3c/GxEPD2_750c_Z90.h>
-#include <GxEPD2_EPD.h>
-
+#include "PanelDescriptor.h"
 #include "epd.h"
 
 
 EPD::EPD(int pinSpiSck, int pinSpiMiso, int pinSpiMosi, int pinSpiCs, int pinDc, int pinRst, int pinBusy, const Logger& parentLogger):
-    _pinSpiSck(pinSpiSck),
-    _pinSpiMiso(pinSpiMiso),
-    _pinSpiMosi(pinSpiMosi),
-    _pinSpiCs(pinSpiCs),
-    _pinDc(pinDc),
-    _pinRst(pinRst),
-    _pinBusy(pinBusy),
-    _logger("epd", parentLogger)
+    _logger("epd", parentLogger),
+    _interface(pinSpiSck, pinSpiMiso, pinSpiMosi, pinSpiCs, pinDc, pinRst, pinBusy)
 {
-    _panelType = GxEPD2::GDEW042T2;  // unfortunately, there's no value for "unknown"
-    _rawPanelPtr = nullptr;
+    _descriptor = nullptr;
+    _panelPtr = nullptr;
+    _isLightSleepEnabled = false;
+    _isStarted = false;
+    _channel = 0;
+    _pass = 0;
+    _isChannelOpen = false;
 }
 
 EPD::~EPD()
 {
     stop();
-    if (_rawPanelPtr != nullptr)
-    {
-        // delete _rawPanelPtr;  // unfortunately, GxEPD2::... has no virtual destructor
-    }
+    delete _panelPtr;
 }
 
 
 // ***** Panel ***************************************************************
 
-EPD::PanelMap EPD::_supportedPanels = {
-    // bw
-    { GxEPD2::GDEW042T2, "GDEW042T2/Waveshare_4_2_bw" },
-    { GxEPD2::GDEW042M01, "GDEW042M01" },
-    { GxEPD2::GDEW0583T7, "GDEW0583T7/Waveshare_5_83_bw" },
-    { GxEPD2::GDEW0583T8, "GDEW0583T8" },
-    { GxEPD2::GDEW075T8, "GDEW075T8/Waveshare_7_5_bw" },
-    { GxEPD2::GDEW075T7, "GDEW075T7/Waveshare_7_5_bw_T7" },
-    { GxEPD2::GDEW1248T3, "GDEW1248T3/Waveshare_12_24_bw" },
-      // 3-color
-    { GxEPD2::GDEW042Z15, "GDEW042Z15/Waveshare_4_2_bwr" },
-    { GxEPD2::GDEW0583Z21, "GDEW0583Z21/Waveshare_5_83_bwr" },
-    { GxEPD2::ACeP565, "ACeP565/Waveshare_5_65_7c" },
-    { GxEPD2::GDEW075Z09, "GDEW075Z09/Waveshare_7_5_bwr" },
-    { GxEPD2::GDEW075Z08, "GDEW075Z08/Waveshare_7_5_bwr_Z08" },
-    { GxEPD2::GDEH075Z90, "GDEH075Z90/Waveshare_7_5_bwr_Z90" }
-};
-
 void EPD::setPanel(GxEPD2::Panel panel)
 {
-    _panelType = panel;
-    GxEPD2_EPD *rawPanelPtr = nullptr;
-    switch (_panelType) {
-        case GxEPD2::GDEW042T2: rawPanelPtr = new GxEPD2_420(_pinSpiCs, _pinDc, _pinRst, _pinBusy); break;
-        case GxEPD2::GDEW042M01: break;
-        case GxEPD2::GDEW0583T7: break;
-        case GxEPD2::GDEW0583T8: break;
-        case GxEPD2::GDEW075T8: break;
-        case GxEPD2::GDEW075T7: break;
-        case GxEPD2::GDEW1248T3: break;
-        case GxEPD2::GDEW042Z15: break;
-        case GxEPD2::GDEW0583Z21: break;
-        case GxEPD2::ACeP565: break;
-        case GxEPD2::GDEW075Z09: break;
-        case GxEPD2::GDEW075Z08: break;
-        case GxEPD2::GDEH075Z90: rawPanelPtr = new GxEPD2_750c_Z90(_pinSpiCs, _pinDc, _pinRst, _pinBusy); break;
-        default: 
-            _logger.error("Panel not supported. Modify EPD::setPanel()");
-            rawPanelPtr = nullptr;
-            break;
+    const PanelDescriptor *descriptor = PanelDescriptor::findGxEPD2(panel);
+    if (descriptor == nullptr)
+    {
+        _logger.error("Panel %d unknown. Add it to PANEL_DESCRIPTORS", (int) panel);
+        return;
     }
+    setPanel(*descriptor);
+}
 
-    // save the result into the internal _rawPanelPtr
-    if (_rawPanelPtr != nullptr)
+/**
+ * Creates the driver of the panel, the previous one is deleted. Nothing
+ * is created if the panel is already set.
+ */
+void EPD::setPanel(const PanelDescriptor& descriptor)
+{
+    if (_descriptor == &descriptor && _panelPtr != nullptr)
     {
-        // delete _rawPanelPtr;  // unfortunately, GxEPD2::... has no virtual destructor
+        return;
     }
-    _rawPanelPtr = rawPanelPtr;
+    stop();
+    delete _panelPtr;
+    _panelPtr = nullptr;
+    _descriptor = &descriptor;
+    if (descriptor.create == nullptr)
+    {
+        _logger.error("Panel %s has no native driver", descriptor.name);
+        return;
+    }
+    _panelPtr = descriptor.create(descriptor);
 }
 
-const std::string& EPD::getPanelName() const
+/// Waveform of the refresh in stop(), full for panels without a fast one
+void EPD::setRefreshMode(Panel::RefreshMode mode)
 {
-    static const auto unknownPanelName = std::string("");
-    auto it = _supportedPanels.find(_panelType);
-    if (it != _supportedPanels.end()) {
-        return it->second;
+    if (_panelPtr != nullptr)
+    {
+        _panelPtr->setRefreshMode(mode);
     }
-    return unknownPanelName;
 }
 
-const EPD::PanelMap& EPD::getSupportedPanels() const
+const char *EPD::getPanelName() const
 {
-    return _supportedPanels;
+    if (_descriptor == nullptr)
+        return "";
+    return _descriptor->alias != nullptr ? _descriptor->alias : _descriptor->name;
 }
 
 
@@ -114,22 +88,29 @@ const EPD::PanelMap& EPD::getSupportedPanels() const
 void EPD::start()
 {
     // check invariants
-    if (_rawPanelPtr == nullptr) {
-        _logger.error("_rawPanelPtr not set. Call EPD::setPanel() first.");
+    if (_panelPtr == nullptr) {
+        _logger.error("_panelPtr not set. Call EPD::setPanel() first.");
         return;
     }
 
     _logger.info("EPD starting");
-    _rawPanelPtr->init(0);
-    SPI.end();
-    SPI.begin(_pinSpiSck, _pinSpiMiso /*not used*/, _pinSpiMosi, _pinSpiCs);
+    _interface.init();
+    _interface.setLightSleep(_isLightSleepEnabled);
+    _panelPtr->init(&_interface);
+    _isStarted = true;
+    _channel = 0;
+    _pass = 0;
+    _isChannelOpen = false;
 }
 
+/**
+ * Writes the next channel, the first call after start() writes channel 0
+ */
 void EPD::displayPixelBuffer(const uint8_t* _bufPtr)
 {
     // check invariants
-    if (_rawPanelPtr == nullptr) {
-        _logger.error("_rawPanelPtr not set.");
+    if (!_isStarted) {
+        _logger.error("EPD not started.");
         return;
     }
     if (_bufPtr == nullptr) {
@@ -137,21 +118,95 @@ void EPD::displayPixelBuffer(const uint8_t* _bufPtr)
         return;
     }
 
-    _logger.info("EPD displaying image & powering off");
-    _rawPanelPtr->writeImage(_bufPtr, 0, 0, _rawPanelPtr->WIDTH, _rawPanelPtr->HEIGHT);
+    endChannel();
+    if (_channel < _panelPtr->getChannels())
+    {
+        _panelPtr->writeChannel(_channel++, _bufPtr);
+    }
+}
+
+int EPD::getChannelPasses(int channel) const
+{
+    return _panelPtr != nullptr ? _panelPtr->getChannelPasses(channel) : 1;
 }
 
-void EPD::stop()
+/**
+ * Writes full width rows, e.g. a band of a frame rendered band by band.
+ * Row 0 starts the next pass of the channel, or the next channel after
+ * its last pass: the caller sends every channel getChannelPasses() times.
+ * Not to be mixed with displayPixelBuffer().
+ */
+void EPD::displayRows(const uint8_t* rowsPtr, int firstRow, int numRows)
 {
     // check invariants
-    if (_rawPanelPtr == nullptr) {
-        _logger.error("_rawPanelPtr not set. Call EPD::setPanel() first.");
+    if (!_isStarted) {
+        _logger.error("EPD not started.");
         return;
     }
 
-    _rawPanelPtr->refresh(false);
-    _rawPanelPtr->hibernate(); // implies powerOff
+    if (firstRow == 0)
+    {
+        endChannel();
+    }
+    if (!_isChannelOpen)
+    {
+        if (_channel >= _panelPtr->getChannels())
+        {
+            return;
+        }
+        _panelPtr->beginChannel(_channel, _pass);
+        _isChannelOpen = true;
+    }
+    _panelPtr->writeRows(rowsPtr, numRows);
+}
+
+/// Ends the open pass and advances to the next pass or channel
+void EPD::endChannel()
+{
+    if (_isChannelOpen)
+    {
+        _panelPtr->endChannel();
+        _isChannelOpen = false;
+        if (++_pass >= _panelPtr->getChannelPasses(_channel))
+        {
+            _channel++;
+            _pass = 0;
+        }
+    }
+}
+
+void EPD::stop()
+{
+    if (!_isStarted) {
+        return;
+    }
+
+    endChannel();
+    _panelPtr->display();
+    _panelPtr->deep_sleep();
+    _isStarted = false;
+    _logger.info("EPD stopped: display in deep sleep");
+}
+
+/**
+ * Refreshes the window x, y, w, h only, previousPtr is the displayed frame.
+ * The panel keeps its content during deep sleep. Panels without partial
+ * refresh are refreshed completely.
+ */
+void EPD::displayPartial(const uint8_t* previousPtr, const uint8_t* currentPtr, int x, int y, int w, int h)
+{
+    // check invariants
+    if (_panelPtr == nullptr) {
+        _logger.error("_panelPtr not set. Call EPD::setPanel() first.");
+        return;
+    }
 
-    SPI.end();
-    _logger.info("EPD stopped: display hibernating");
+    _logger.info("EPD partial update of %dx%d at %d,%d", w, h, x, y);
+    _interface.init();
+    _interface.setLightSleep(_isLightSleepEnabled);
+    _panelPtr->init(&_interface);
+    const DiffRect rect = { (int16_t) x, (int16_t) y, (int16_t) w, (int16_t) h };
+    _panelPtr->displayPartial(previousPtr, currentPtr, rect);
+    _panelPtr->deep_sleep();
+    _logger.info("EPD stopped: display in deep sleep");
 }
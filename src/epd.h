@@ -6,20 +6,22 @@
 #ifndef EPD_H
 #define EPD_H
 
-#include <string>
-#include <map>
-
 #include "GxEPD2.h"
-#include "GxEPD2_EPD.h"
 
 #include "logger.h"
+#include "Panel.h"
+#include "PanelInterface.h"
 
 
+/**
+ * Panel selected by its GxEPD2::Panel type, driven by the native Panel of
+ * its descriptor (see PANEL_DESCRIPTORS) on its own PanelInterface. The
+ * planes and rows are streamed to the controller as they are written, the
+ * refresh follows in stop().
+ */
 class EPD
 {
 public:
-    typedef std::map<GxEPD2::Panel, std::string> PanelMap;
-
     EPD(int pinSpiSck, int pinSpiMiso, int pinSpiMosi, int pinSpiCs, 
         int pinDc, int pinRst, int pinBusy, 
         const Logger& parentLogger = rootLogger);
@@ -27,27 +29,40 @@ public:
 
     // get/set panel type
     void setPanel(GxEPD2::Panel panel);
-    GxEPD2::Panel getPanelType() const { return _panelType; }
-    GxEPD2_EPD* getPanelPtr() const { return _rawPanelPtr; }
-    const std::string& getPanelName() const;
-    const PanelMap& getSupportedPanels() const;
+    void setPanel(const PanelDescriptor& descriptor);
+    Panel* getPanel() const { return _panelPtr; }
+    /// Interface all traffic of the panel passes, e.g. for its PanelTrace
+    PanelInterface& getInterface() { return _interface; }
+    /// Name in PANEL_DESCRIPTORS, its alias where the panel was renamed, "" if none is set
+    const char *getPanelName() const;
+
+    void setRefreshMode(Panel::RefreshMode mode);
 
     void start();
     void displayPixelBuffer(const uint8_t* _bufPtr);
+    /// Passes of displayRows() per channel, see Panel::getChannelPasses()
+    int getChannelPasses(int channel) const;
+    void displayRows(const uint8_t* rowsPtr, int firstRow, int numRows);
     void stop();
 
+    // complete update of a window, starts and stops the panel
+    void displayPartial(const uint8_t* previousPtr, const uint8_t* currentPtr, int x, int y, int w, int h);
+
+    // light sleep while the panel is busy, WiFi should be off
+    void setLightSleep(bool isEnabled) { _isLightSleepEnabled = isEnabled; }
+
 private:
-    int _pinSpiSck;
-    int _pinSpiMiso;
-    int _pinSpiMosi;
-    int _pinSpiCs;
-    int _pinDc;
-    int _pinRst;
-    int _pinBusy;
+    void endChannel();
+
     Logger _logger;
-    static PanelMap _supportedPanels;
-    GxEPD2::Panel _panelType;
-    GxEPD2_EPD* _rawPanelPtr;
+    PanelInterface _interface;
+    const PanelDescriptor* _descriptor;
+    Panel* _panelPtr;
+    bool _isLightSleepEnabled;
+    bool _isStarted;
+    int _channel;           //< next channel of displayPixelBuffer() and displayRows()
+    int _pass;              //< next pass of _channel in displayRows()
+    bool _isChannelOpen;
 };
 
 #endif
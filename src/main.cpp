@@ -6,6 +6,8 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <esp_log.h>
+#include <sys/time.h>
+#include <time.h>
 #include <tuple>
 
 #include <ArduinoJson.h>
@@ -20,6 +22,12 @@
 #include "Panel.h"
 #include "PanelFactory.h"
 #include "PixelBuffer.h"
+#include "LayoutRenderer.h"
+#include "DisplayList.h"
+#include "FrameDiff.h"
+#include "RefreshPlanner.h"
+#include "FrameStore.h"
+#include "MemoryPlanner.h"
 #include "epd.h"
 #include "settings.h"
 
@@ -48,7 +56,20 @@ auto panelInterface = PanelInterface(EPD_SCK, EPD_MISO, EPD_MOSI, EPD_CS, EPD_DC
 auto panelFactory = PanelFactory();
 Panel* pPanel = nullptr;
 
+// further panels on the same bus, see EPD_EXTRA_PANELS
+constexpr int MAX_EXTRA_PANELS = 4;
+PanelInterface* extraPanelInterfaces[MAX_EXTRA_PANELS] = {};
+Panel* extraPanels[MAX_EXTRA_PANELS] = {};
+int extraPanelCount = 0;
+
+// with several panels, displayFrame() only starts the refresh, see finishRefreshes()
+bool isRefreshDeferred = false;
+Panel* refreshingPanels[1 + MAX_EXTRA_PANELS] = {};
+int refreshingPanelCount = 0;
+
 auto epd = EPD(EPD_SCK, EPD_MISO, EPD_MOSI, EPD_CS, EPD_DC, EPD_RST, EPD_BUSY);
+auto frameStore = FrameStore("/background.epf");
+auto lastFrameStore = FrameStore("/frame.epf");   // last frame without the clock
 
 // ***** Data stored in RTC memory is preserved during deep sleep ************
 constexpr int MAX_RTC_CONFIG_SIZE = 1024;
@@ -60,6 +81,22 @@ RTC_DATA_ATTR int bootCount = 0;
 RTC_DATA_ATTR unsigned long activeDuration_ms = 0;
 RTC_DATA_ATTR unsigned long sleepDuration_ms = 0;
 RTC_DATA_ATTR int imageResponseCode = 0;
+RTC_DATA_ATTR uint64_t rtc_frame_hash = 0;   // hash of the displayed frame
+RTC_DATA_ATTR uint64_t rtc_extra_frame_hash[MAX_EXTRA_PANELS] = {};
+
+// Refreshes since the last clean one per panel (0 = main panel), see RefreshPlanner
+RTC_DATA_ATTR RefreshPlanner::History rtc_refresh_history[1 + MAX_EXTRA_PANELS] = {};
+
+// The system time keeps running on the RTC timer during deep sleep.
+RTC_DATA_ATTR bool rtc_is_time_synced = false;  // system time set from an HTTP Date header
+RTC_DATA_ATTR time_t rtc_next_fetch_time = 0;   // next network update, 0 = on the next wake
+RTC_DATA_ATTR time_t rtc_fetch_time = 0;        // time of the displayed data
+RTC_DATA_ATTR time_t rtc_clock_time = 0;        // time shown by the displayed clock
+RTC_DATA_ATTR uint64_t rtc_base_hash = 0;       // hash of the frame in lastFrameStore
+
+#ifdef PANEL_TRACE
+RTC_DATA_ATTR PanelTrace::Summary rtc_trace_summary = {};  // panel traffic of the last update
+#endif
 
 unsigned long updateInterval_s = 0;
 unsigned long bootTimestamp;
@@ -244,7 +281,18 @@ String getStatusAsJson(Panel* pPanel) {
         jsonPanel["bitsPerChannel"] = pPanel->getBitsPerChannel();
         jsonPanel["width"] = pPanel->getWidth();
         jsonPanel["height"] = pPanel->getHeight();
+        jsonPanel["rotation"] = EPD_ROTATION;
     }
+#ifdef PANEL_TRACE
+    auto jsonTrace = json.createNestedObject("trace");
+    jsonTrace["commands"] = rtc_trace_summary.commands;
+    jsonTrace["transactions"] = rtc_trace_summary.transactions;
+    jsonTrace["data_bytes"] = rtc_trace_summary.dataBytes;
+    jsonTrace["transfer_us"] = rtc_trace_summary.transfer_us;
+    jsonTrace["busy_ms"] = rtc_trace_summary.busy_ms;
+    jsonTrace["slowest_command"] = rtc_trace_summary.slowestCommand;
+    jsonTrace["slowest_busy_ms"] = rtc_trace_summary.slowestBusy_ms;
+#endif
 
     char _body[1024];
     serializeJson(json, _body, sizeof(_body));
@@ -263,6 +311,688 @@ void log_memory_usage()
 }
 
 
+// ***** Local clock *********************************************************
+
+const int CLOCK_X = 5;
+const int CLOCK_Y = 5;
+const int CLOCK_GLYPHS = 5;
+
+/**
+ * Light sleep while the panels are busy (EPD_LIGHT_SLEEP), to be enabled
+ * only while WiFi is off: the SoC would drop the connection
+ */
+void setPanelLightSleep(bool isWifiOff)
+{
+    panelInterface.setLightSleep(EPD_LIGHT_SLEEP && isWifiOff);
+    epd.setLightSleep(EPD_LIGHT_SLEEP && isWifiOff);
+    for (int i = 0; i < extraPanelCount; i++)
+    {
+        extraPanelInterfaces[i]->setLightSleep(EPD_LIGHT_SLEEP && isWifiOff);
+    }
+}
+
+/**
+ * Sets the system time from an HTTP Date header,
+ * e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+ */
+void syncClock(const String& date)
+{
+    struct tm tm = {};
+    if (date.isEmpty() || strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S", &tm) == nullptr)
+    {
+        return;
+    }
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    struct timeval tv = { mktime(&tm), 0 };
+    settimeofday(&tv, nullptr);
+    setenv("TZ", EPD_TIMEZONE, 1);
+    tzset();
+    rtc_is_time_synced = true;
+}
+
+/**
+ * "HH:MM" once the time is known, otherwise the age of the displayed data
+ * in minutes, always CLOCK_GLYPHS characters
+ */
+String getClockText(time_t t)
+{
+    char text[CLOCK_GLYPHS + 1];
+    if (rtc_is_time_synced)
+    {
+        struct tm tm;
+        localtime_r(&t, &tm);
+        snprintf(text, sizeof(text), "%02d:%02d", tm.tm_hour, tm.tm_min);
+    } else {
+        long age_min = (t - rtc_fetch_time) / 60;
+        snprintf(text, sizeof(text), "%5ld", -(age_min < 9999 ? age_min : 9999));
+    }
+    return String(text);
+}
+
+/**
+ * Draws the clock into all planes
+ */
+void drawClock(PixelBuffer& pb, Panel* pPanel, time_t t)
+{
+    const String text = getClockText(t);
+    for (int channelNo = 0; channelNo < pb.getPlanes(); channelNo++)
+    {
+        pb.selectPlane(channelNo);
+        pb.drawGlyphs(CLOCK_X, CLOCK_Y, pPanel->getDefaultColor(channelNo), text.c_str());
+    }
+    pb.selectPlane(0);
+}
+
+/**
+ * Frames displayed without a frame buffer are neither hashed nor stored, so
+ * the next update is a full one.
+ */
+void forgetFrame()
+{
+    rtc_frame_hash = 0;
+    if (rtc_base_hash != 0)
+    {
+        lastFrameStore.remove();
+        rtc_base_hash = 0;
+    }
+}
+
+
+// ***** Display *************************************************************
+
+/**
+ * Draws the locally rendered status indicators for a channel into the
+ * selected plane
+ */
+void drawOverlays(PixelBuffer& pb, Panel* pPanel, int channelNo)
+{
+    pb.drawBattery(pb.width() - 22 - 5, 5, /*color*/pPanel->getDefaultColor(channelNo), battery.getVoltage_mV(), battery.getPercentage());
+    pb.drawWiFi(pb.width() - 22 - 5 - 14 - 5, 5, /*color*/pPanel->getDefaultColor(channelNo), net.getRSSI());
+    // pb.setTextColor(pPanel->getDefaultColor(channelNo));
+    // pb.setTextSize(3);
+    // pb.setCursor(50, 5); pb.printf("Test %d", bootCount);
+}
+
+/**
+ * Draws the locally rendered status indicators into all planes
+ */
+void drawOverlays(PixelBuffer& pb, Panel* pPanel)
+{
+    for (int channelNo = 0; channelNo < pb.getPlanes(); channelNo++)
+    {
+        pb.selectPlane(channelNo);
+        drawOverlays(pb, pPanel, channelNo);
+    }
+    pb.selectPlane(0);
+}
+
+/**
+ * Plans the refresh of a frame which is not compared with the displayed
+ * one: fast while the ghosting budget of the panel lasts, otherwise a clean
+ * full refresh which renews the budget
+ */
+Panel::RefreshMode planFullRefresh(Panel* pPanel, int panelNo)
+{
+    const time_t now = time(nullptr);
+    const RefreshPlanner::Plan plan = RefreshPlanner(*pPanel, EPD_FAST_REFRESH, EPD_LIGHT_SLEEP)
+        .planFull(rtc_refresh_history[panelNo], now);
+    RefreshPlanner::record(plan, rtc_refresh_history[panelNo], now);
+    return plan.mode == RefreshPlanner::FAST ? Panel::REFRESH_FAST : Panel::REFRESH_FULL;
+}
+
+/**
+ * Powers up the panel, transfers all planes, refreshes and hibernates it.
+ * panelNo is 0 for the main panel, n for EPD_EXTRA_PANELS[n - 1]. With
+ * isRefreshDeferred, the panel is left refreshing for finishRefreshes().
+ */
+void displayFrame(PixelBuffer& pb, Panel* pPanel, Panel::RefreshMode mode, int panelNo = 0)
+{
+#ifdef NATIVE_PANEL
+    PanelInterface* pInterface = panelNo == 0 ? &panelInterface : extraPanelInterfaces[panelNo - 1];
+    pInterface->init();
+    pPanel->init(pInterface);
+    for (int channelNo = 0; channelNo < pb.getPlanes(); channelNo++)
+    {
+        pPanel->writeChannel(channelNo, pb.getBufPtr(channelNo));
+        delay(1); // satisfy the task watchdog
+    }
+    pPanel->setRefreshMode(mode);
+    pPanel->startDisplay();
+    if (isRefreshDeferred)
+    {
+        refreshingPanels[refreshingPanelCount++] = pPanel;
+        return;
+    }
+    pPanel->waitDisplay();
+    pPanel->deep_sleep();
+#else
+    epd.setPanel(pPanel->getDescriptor());
+    epd.setRefreshMode(mode);
+    epd.start();
+    for (int channelNo = 0; channelNo < pb.getPlanes(); channelNo++)
+    {
+        epd.displayPixelBuffer(pb.getBufPtr(channelNo));
+        delay(1); // satisfy the task watchdog
+    }
+    epd.stop();
+#endif
+}
+
+/**
+ * Refreshes the window rect only, falls back to a full refresh for panels
+ * with more than one channel
+ */
+void displayPartialFrame(PixelBuffer& previous, PixelBuffer& current, const DiffRect& rect, Panel* pPanel)
+{
+    if (current.getPlanes() > 1)
+    {
+        displayFrame(current, pPanel, Panel::REFRESH_FULL);
+        return;
+    }
+#ifdef NATIVE_PANEL
+    panelInterface.init();
+    pPanel->init(&panelInterface);
+    pPanel->displayPartial(previous.getBufPtr(0), current.getBufPtr(0), rect);
+    pPanel->deep_sleep();
+#else
+    epd.setPanel(pPanel->getDescriptor());
+    epd.displayPartial(previous.getBufPtr(0), current.getBufPtr(0), rect.x, rect.y, rect.w, rect.h);
+#endif
+}
+
+/**
+ * Compares current with the displayed frame previous, both in panel
+ * layout, and refreshes the main panel as planned by RefreshPlanner
+ */
+void displayPlannedFrame(PixelBuffer& previous, PixelBuffer& current, Panel* pPanel)
+{
+    auto diff = FrameDiff(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel());
+    for (int channelNo = 0; channelNo < current.getPlanes(); channelNo++)
+    {
+        diff.compare(current.getBufPtr(channelNo), previous.getBufPtr(channelNo));
+    }
+
+    const time_t now = time(nullptr);
+    const RefreshPlanner::Plan plan = RefreshPlanner(*pPanel, EPD_FAST_REFRESH, EPD_LIGHT_SLEEP)
+        .plan(diff, rtc_refresh_history[0], now);
+    switch (plan.mode) {
+    case RefreshPlanner::NONE:
+        break;
+    case RefreshPlanner::PARTIAL:
+        displayPartialFrame(previous, current, plan.window, pPanel);
+        break;
+    case RefreshPlanner::FAST:
+        displayFrame(current, pPanel, Panel::REFRESH_FAST);
+        break;
+    default:
+        displayFrame(current, pPanel, Panel::REFRESH_FULL);
+        break;
+    }
+    RefreshPlanner::record(plan, rtc_refresh_history[0], now);
+}
+
+/**
+ * Rasterises a display list band by band and streams the bands to the
+ * panel, so no frame buffer is needed. Every channel is rendered in its own
+ * sweep over the bands.
+ */
+bool displayDisplayList(const uint8_t *data, size_t length, Panel* pPanel)
+{
+    DisplayList displayList(data, length);
+    auto band = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel());
+    band.setPlaneColors(pPanel->getChannelRgbColors());
+    band.setRotation(EPD_ROTATION);
+    if (!band.allocateBand(DisplayList::DEFAULT_BAND_ROWS) || !displayList.validate(band))
+    {
+        return false;
+    }
+
+    bool isOk = true;
+#ifdef NATIVE_PANEL
+    panelInterface.init();
+    pPanel->init(&panelInterface);
+    for (int channelNo = 0; channelNo < pPanel->getChannels(); channelNo++)
+    {
+        for (int pass = 0; pass < pPanel->getChannelPasses(channelNo); pass++)
+        {
+            pPanel->beginChannel(channelNo, pass);
+            isOk = isOk && displayList.render(band, channelNo, [](const uint8_t *rows, int firstRow, int numRows)
+            {
+                pPanel->writeRows(rows, numRows);
+            });
+            pPanel->endChannel();
+            delay(1); // satisfy the task watchdog
+        }
+    }
+    if (isOk)
+    {
+        pPanel->setRefreshMode(planFullRefresh(pPanel, 0));
+        pPanel->display();
+    }
+    pPanel->deep_sleep();
+#else
+    epd.setPanel(pPanel->getDescriptor());
+    epd.setRefreshMode(planFullRefresh(pPanel, 0));
+    epd.start();
+    for (int channelNo = 0; channelNo < pPanel->getChannels(); channelNo++)
+    {
+        for (int pass = 0; pass < epd.getChannelPasses(channelNo); pass++)
+        {
+            isOk = isOk && displayList.render(band, channelNo, [](const uint8_t *rows, int firstRow, int numRows)
+            {
+                epd.displayRows(rows, firstRow, numRows);
+            });
+            delay(1); // satisfy the task watchdog
+        }
+    }
+    epd.stop();
+#endif
+    return isOk;
+}
+
+/**
+ * Decodes the PNG band by band straight into the panel, without a frame
+ * buffer. The image is decoded once per channel and panel pass, the
+ * overlays are composited into each band on its way to the panel.
+ */
+bool displayPngStream(String& png, Panel* pPanel)
+{
+    auto band = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel());
+    band.setPlaneColors(pPanel->getChannelRgbColors());
+    if (!band.preparePngStream((unsigned char*)png.c_str(), png.length(), DisplayList::DEFAULT_BAND_ROWS)
+        || !band.isPngStreamable())
+    {
+        rootLogger.error("Cannot stream the image");
+        return false;
+    }
+
+    bool isOk = true;
+#ifdef NATIVE_PANEL
+    panelInterface.init();
+    pPanel->init(&panelInterface);
+    for (int channelNo = 0; channelNo < pPanel->getChannels(); channelNo++)
+    {
+        for (int pass = 0; pass < pPanel->getChannelPasses(channelNo); pass++)
+        {
+            pPanel->beginChannel(channelNo, pass);
+            isOk = isOk && band.streamPng(channelNo, [&](const uint8_t *rows, int firstRow, int numRows)
+            {
+                drawOverlays(band, pPanel, channelNo);
+                pPanel->writeRows(rows, numRows);
+            });
+            pPanel->endChannel();
+            delay(1); // satisfy the task watchdog
+        }
+    }
+    if (isOk)
+    {
+        pPanel->setRefreshMode(planFullRefresh(pPanel, 0));
+        pPanel->display();
+    }
+    pPanel->deep_sleep();
+#else
+    epd.setPanel(pPanel->getDescriptor());
+    epd.setRefreshMode(planFullRefresh(pPanel, 0));
+    epd.start();
+    for (int channelNo = 0; channelNo < pPanel->getChannels(); channelNo++)
+    {
+        for (int pass = 0; pass < epd.getChannelPasses(channelNo); pass++)
+        {
+            isOk = isOk && band.streamPng(channelNo, [&](const uint8_t *rows, int firstRow, int numRows)
+            {
+                drawOverlays(band, pPanel, channelNo);
+                epd.displayRows(rows, firstRow, numRows);
+            });
+            delay(1); // satisfy the task watchdog
+        }
+    }
+    epd.stop();
+#endif
+    forgetFrame();
+    return isOk;
+}
+
+/**
+ * Adds the overlays and displays the frame unless it is pixel identical to
+ * the displayed one. With the local clock or a panel with partial refresh,
+ * the frame is kept in flash without the clock, for the clock updates
+ * between the network fetches and to compare the next frame with.
+ */
+void showFrame(PixelBuffer& pb, Panel* pPanel)
+{
+    delay(1); // satisfy the task watchdog
+    drawOverlays(pb, pPanel);
+
+    // the displayed frame is the stored one with the clock shown, if any
+    auto previous = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel(), pPanel->getChannels());
+    previous.setFrameRotation(EPD_ROTATION);
+    previous.setPlaneColors(pPanel->getChannelRgbColors());
+    bool hasPrevious = pPanel->supportsPartialRefresh() && rtc_base_hash != 0 && lastFrameStore.load(previous, "");
+    if (hasPrevious)
+    {
+        if (EPD_CLOCK_INTERVAL_S > 0)
+        {
+            drawClock(previous, pPanel, rtc_clock_time);
+        }
+        previous.rotateToPanel();
+        hasPrevious = previous.getHash() == rtc_frame_hash;
+    }
+
+    if (EPD_CLOCK_INTERVAL_S > 0 || pPanel->supportsPartialRefresh())
+    {
+        uint64_t baseHash = pb.getHash();
+        if (baseHash != rtc_base_hash)
+        {
+            rtc_base_hash = lastFrameStore.save(pb, "") ? baseHash : 0;
+        }
+    }
+    if (EPD_CLOCK_INTERVAL_S > 0)
+    {
+        rtc_fetch_time = time(nullptr);
+        rtc_clock_time = rtc_fetch_time;
+        drawClock(pb, pPanel, rtc_clock_time);
+    }
+    pb.rotateToPanel();
+
+    // a new image version may still be pixel identical to the displayed one
+    uint64_t frameHash = pb.getHash();
+    if (frameHash == rtc_frame_hash)
+    {
+        rootLogger.info("Frame unchanged (hash %016llx), skipping the display refresh", frameHash);
+        return;
+    }
+    if (hasPrevious)
+    {
+        displayPlannedFrame(previous, pb, pPanel);
+    } else {
+        displayFrame(pb, pPanel, planFullRefresh(pPanel, 0));
+    }
+    rtc_frame_hash = frameHash;
+}
+
+/**
+ * Displays an image response: a display list is streamed band by band,
+ * PNG images and JSON layouts are rendered into a frame buffer first.
+ */
+bool displayResponse(String& body, const String& contentType, Panel* pPanel)
+{
+    if (DisplayList::isDisplayList((const uint8_t*)body.c_str(), body.length()))
+    {
+        if (!displayDisplayList((const uint8_t*)body.c_str(), body.length(), pPanel))
+        {
+            rootLogger.error("Error rendering the display list");
+            return false;
+        }
+        forgetFrame();
+        return true;
+    }
+
+    const bool isLayout = contentType.startsWith("application/json");
+    if (!isLayout && EPD_ROTATION == 0 && (EPD_STREAM_PNG || MemoryPlanner::isStreaming()))
+    {
+        return displayPngStream(body, pPanel);
+    }
+
+    // create pixel buffers from a png or a json layout and display them
+    auto pb = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel(), pPanel->getChannels());
+    pb.setFrameRotation(EPD_ROTATION);
+    pb.setPlaneColors(pPanel->getChannelRgbColors());
+
+    bool isFrameOk;
+    if (isLayout)
+    {
+        isFrameOk = pb.allocateBuf()
+            && LayoutRenderer(pb).render(body.c_str(), body.length());
+    } else {
+        isFrameOk = pb.prepareBufForPng((unsigned char*)body.c_str(), body.length())
+            && pb.writePngToBuffer();
+    }
+    if (!isFrameOk)
+    {
+        rootLogger.error("Error creating Pixel Buffer");
+        return false;
+    }
+
+    showFrame(pb, pPanel);
+    return true;
+}
+
+/**
+ * Template mode: the background is fetched only if its version (ETag)
+ * differs from the one stored in flash, the values are a JSON layout
+ * drawn on top of it.
+ */
+bool displayTemplate(Panel* pPanel)
+{
+    auto pb = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel(), pPanel->getChannels());
+    pb.setFrameRotation(EPD_ROTATION);
+    pb.setPlaneColors(pPanel->getChannelRgbColors());
+
+    // background
+    String version = frameStore.getVersion();
+    auto httpBackgroundClient = HttpClient(/*debug*/ false);
+    httpBackgroundClient.startRequest("GET", base_url + "epaper/api/displays/" + net.getDeviceId() + "/background", "", version);
+    httpBackgroundClient.waitForCompletionUntil(bootTimestamp + 5000);
+    if (httpBackgroundClient.getResponseCode() == 304)
+    {
+        if (!frameStore.load(pb, version))
+        {
+            // fetch the complete background next time
+            frameStore.remove();
+            return false;
+        }
+    }
+    else if (httpBackgroundClient.isResponseLengthOk() && httpBackgroundClient.getResponseCode() == 200)
+    {
+        String& png = httpBackgroundClient.getResponseText();
+        if (!pb.prepareBufForPng((unsigned char*)png.c_str(), png.length()) || !pb.writePngToBuffer())
+        {
+            rootLogger.error("Error creating Pixel Buffer");
+            return false;
+        }
+        frameStore.save(pb, httpBackgroundClient.getResponseHeader("ETag"));
+    } else {
+        rootLogger.error("Background response code %d, nothing to display!", httpBackgroundClient.getResponseCode());
+        return false;
+    }
+
+    // values
+    auto httpValuesClient = HttpClient(/*debug*/ false);
+    httpValuesClient.startRequest("GET", base_url + "epaper/api/displays/" + net.getDeviceId() + "/values", "");
+    httpValuesClient.waitForCompletionUntil(bootTimestamp + 5000);
+    updateInterval_s = httpValuesClient.getResponseMaxAgeSeconds(updateInterval_s);
+    syncClock(httpValuesClient.getResponseDate());
+    if (!httpValuesClient.isResponseLengthOk() || httpValuesClient.getResponseCode() != 200)
+    {
+        rootLogger.error("Values response code %d, nothing to display!", httpValuesClient.getResponseCode());
+        return false;
+    }
+    String& values = httpValuesClient.getResponseText();
+    if (!LayoutRenderer(pb).render(values.c_str(), values.length()))
+    {
+        return false;
+    }
+    showFrame(pb, pPanel);
+    return true;
+}
+
+/**
+ * Local wake without network: draws the current clock into the stored frame
+ * and refreshes it as planned, usually the changed window only. The
+ * previous frame is rebuilt from the stored frame and the clock time shown.
+ * Returns false if there is no stored frame.
+ */
+bool updateClock(Panel* pPanel)
+{
+    const time_t now = time(nullptr);
+    if (getClockText(now) == getClockText(rtc_clock_time))
+    {
+        rootLogger.info("Clock unchanged");
+        return true;
+    }
+
+    auto previous = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel(), pPanel->getChannels());
+    previous.setFrameRotation(EPD_ROTATION);
+    previous.setPlaneColors(pPanel->getChannelRgbColors());
+    auto current = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel(), pPanel->getChannels());
+    current.setFrameRotation(EPD_ROTATION);
+    current.setPlaneColors(pPanel->getChannelRgbColors());
+    if (rtc_base_hash == 0 || !lastFrameStore.load(previous, "") || !current.allocateBuf())
+    {
+        return false;
+    }
+    memcpy(current.getBufPtr(), previous.getBufPtr(), previous.getBufSize());
+    drawClock(previous, pPanel, rtc_clock_time);
+    drawClock(current, pPanel, now);
+    previous.rotateToPanel();
+    current.rotateToPanel();
+
+    rootLogger.info("Clock update %s", getClockText(now).c_str());
+    displayPlannedFrame(previous, current, pPanel);
+    rtc_clock_time = now;
+    rtc_frame_hash = current.getHash();
+    return true;
+}
+
+
+// ***** Further panels ******************************************************
+
+/**
+ * Creates the panels of EPD_EXTRA_PANELS, each with its own interface on
+ * the shared SPI bus
+ */
+void createExtraPanels()
+{
+#ifdef NATIVE_PANEL
+    extraPanelCount = EPD_EXTRA_PANEL_COUNT < MAX_EXTRA_PANELS ? EPD_EXTRA_PANEL_COUNT : MAX_EXTRA_PANELS;
+    for (int i = 0; i < extraPanelCount; i++)
+    {
+        const EpdPanelConfig& config = EPD_EXTRA_PANELS[i];
+        extraPanels[i] = panelFactory.createPanel(config.name);
+        if (extraPanels[i] == nullptr)
+        {
+            rootLogger.error("Panel %s is unknown", config.name);
+            panic();
+        }
+        extraPanelInterfaces[i] = new PanelInterface(EPD_SCK, EPD_MISO, EPD_MOSI, config.cs, config.dc, config.rst, config.busy);
+    }
+#endif
+}
+
+/**
+ * Fetches, transfers and starts the refresh of each further panel. The
+ * refreshes run while the next image is downloaded and transferred.
+ */
+void displayExtraPanels()
+{
+    for (int i = 0; i < extraPanelCount; i++)
+    {
+        Panel *pExtraPanel = extraPanels[i];
+        auto httpImageClient = HttpClient(/*debug*/ false);
+        httpImageClient.startRequest("GET", base_url + "epaper/api/displays/" + net.getDeviceId() + "/image?panel=" + String(i + 1), "");
+        httpImageClient.waitForCompletionUntil(millis() + 5000);
+        if (!httpImageClient.isResponseLengthOk() || httpImageClient.getResponseCode() != 200)
+        {
+            rootLogger.error("Panel %d: response code %d, nothing to display!", i + 1, httpImageClient.getResponseCode());
+            continue;
+        }
+
+        String& png = httpImageClient.getResponseText();
+        auto pb = PixelBuffer(pExtraPanel->getWidth(), pExtraPanel->getHeight(), pExtraPanel->getBitsPerChannel(), pExtraPanel->getChannels());
+        pb.setFrameRotation(EPD_ROTATION);
+        pb.setPlaneColors(pExtraPanel->getChannelRgbColors());
+        if (!pb.prepareBufForPng((unsigned char*)png.c_str(), png.length()) || !pb.writePngToBuffer())
+        {
+            rootLogger.error("Panel %d: error creating Pixel Buffer", i + 1);
+            continue;
+        }
+        drawOverlays(pb, pExtraPanel);
+        pb.rotateToPanel();
+
+        const uint64_t frameHash = pb.getHash();
+        if (frameHash == rtc_extra_frame_hash[i])
+        {
+            rootLogger.info("Panel %d: frame unchanged, skipping the display refresh", i + 1);
+            continue;
+        }
+        displayFrame(pb, pExtraPanel, planFullRefresh(pExtraPanel, i + 1), i + 1);
+        rtc_extra_frame_hash[i] = frameHash;
+    }
+}
+
+/// Waits for the refreshes started with isRefreshDeferred and hibernates the panels
+void finishRefreshes()
+{
+    const unsigned long start_ms = millis();
+    for (int i = 0; i < refreshingPanelCount; i++)
+    {
+        refreshingPanels[i]->waitDisplay();
+        refreshingPanels[i]->deep_sleep();
+    }
+    if (refreshingPanelCount > 1)
+    {
+        rootLogger.info("%d panels refreshed in parallel, waited %lu ms", refreshingPanelCount, millis() - start_ms);
+    }
+    refreshingPanelCount = 0;
+    isRefreshDeferred = false;
+}
+
+
+// ***************************************************************************
+
+/**
+ * Sleeps until the next network update or, with the local clock, until the
+ * next clock tick, whichever comes first
+ */
+void enterDeepSleep(bool isNetworkWake)
+{
+    const time_t now = time(nullptr);
+    long sleep_ms;
+    if (isNetworkWake)
+    {
+        net.disconnect();
+        sleep_ms = (long) (bootTimestamp + updateInterval_s * 1000l - millis());
+        if (sleep_ms < (long) min_update_interval_s * 1000l)
+        {
+            sleep_ms = min_update_interval_s * 1000l;
+        }
+        rtc_next_fetch_time = now + sleep_ms / 1000;
+    } else {
+        sleep_ms = (rtc_next_fetch_time - now) * 1000l;
+    }
+    if (EPD_CLOCK_INTERVAL_S > 0)
+    {
+        const long tick_ms = (EPD_CLOCK_INTERVAL_S - now % EPD_CLOCK_INTERVAL_S) * 1000l;
+        if (tick_ms < sleep_ms)
+        {
+            sleep_ms = tick_ms;
+        }
+    }
+    sleepDuration_ms = sleep_ms > 1000 ? sleep_ms : 1000;
+
+#ifdef PANEL_TRACE
+    // keep the summary of the last wake which talked to the panel
+#ifdef NATIVE_PANEL
+    PanelTrace& trace = panelInterface.getTrace();
+#else
+    PanelTrace& trace = epd.getInterface().getTrace();
+#endif
+    if (trace.getSummary().transactions > 0)
+    {
+        rtc_trace_summary = trace.getSummary();
+        trace.dump();
+    }
+#endif
+    activeDuration_ms = millis() - bootTimestamp;
+    rootLogger.info("System was awake for %.3f s", activeDuration_ms / 1000.0);
+    rootLogger.info("System entering deep sleep state for %.3f s...", sleepDuration_ms / 1000.0);
+    digitalWrite(BUILTIN_LED, LOW);
+    esp_sleep_enable_timer_wakeup(sleepDuration_ms * 1000LL);
+    esp_deep_sleep_start();
+}
+
+
 // ***************************************************************************
 //             SETUP
 // ***************************************************************************
@@ -295,24 +1025,37 @@ void setup()
 #endif
     statusLed.set(true);
     rootLogger.info("Startup #%d  Battery=%d mV/%d%%", bootCount, battery.getVoltage_mV(), battery.getPercentage());
+    setenv("TZ", EPD_TIMEZONE, 1);
+    tzset();
 
-    net.connect();
-    if ( net.waitUntilConnected(bootTimestamp + 5000) )
+    // begin unfinished refactoring
+    const char *panelName = EPD_PANEL_NAME;
+    panelFactory.init();
+    pPanel = panelFactory.createPanel(panelName);
+    if (pPanel == nullptr)
+    {
+        rootLogger.error("Panel %s is unknown", panelName);
+        panic();
+    }
+    bool isMemoryOk = MemoryPlanner::plan(*pPanel, EPD_ROTATION);
+    createExtraPanels();
+
+    // -----------------------------------------------------------------------
+    // Local wake: WiFi stays off, only the clock is updated
+    if (EPD_CLOCK_INTERVAL_S > 0 && isMemoryOk && time(nullptr) < rtc_next_fetch_time)
     {
-        // begin unfinished refactoring
-        const char *panelName = "Waveshare-042bw";
-        panelInterface.init();  // PANEL
-        panelFactory.init();
-        pPanel = panelFactory.createPanel(panelName);
-        if (pPanel == nullptr)
+        setPanelLightSleep(/*isWifiOff*/ true);
+        if (updateClock(pPanel))
         {
-            rootLogger.error("Panel %s is unknown", panelName);
-            panic();
+            enterDeepSleep(/*isNetworkWake*/ false);
         }
-        epd.setPanel(GxEPD2::Waveshare_4_2_bw); // EPD
-        epd.start();                            // EPD
-        //pPanel->init(&panelInterface);  // PANEL
+        rootLogger.info("No stored frame for the clock, updating now");
+        setPanelLightSleep(/*isWifiOff*/ false);
+    }
 
+    net.connect();
+    if ( net.waitUntilConnected(bootTimestamp + 5000) )
+    {
         // report status
         asyncHTTPrequest statusRequest;
         String statusUrl = base_url + "iot/api/epaper/" + net.getDeviceId() + "/status";
@@ -326,74 +1069,69 @@ void setup()
             rootLogger.error("HttpClient cannot open connection! POST %s", statusUrl.c_str());
         }
 
-        // get new image
-        auto httpImageClient = HttpClient(/*debug*/ false);
-        httpImageClient.startRequest("GET", base_url + "epaper/api/displays/" + net.getDeviceId() + "/image", "", "abc"/*etag.get()*/); // TODO REMOVE ME
-
-        // Wait for image data...
-        httpImageClient.waitForCompletionUntil(bootTimestamp + 5000);
-        updateInterval_s = httpImageClient.getResponseMaxAgeSeconds(updateInterval_s);
-        //httpImageClient.log();
-
-        // Display the image
-        if ( httpImageClient.isResponseLengthOk() && httpImageClient.getResponseCode() == 200 )
+        if (!isMemoryOk)
+        {
+            // the update would fail anyway, do not spend energy on the download
+            rootLogger.error("Panel %s does not fit into memory, skipping the update", pPanel->getName());
+        }
+        else if (EPD_TEMPLATE_MODE)
         {
-            // shut down networking if not longer needed - might destrpy response code
-            if ( statusRequest.readyState() == 4 )
+            if (MemoryPlanner::isStreaming())
             {
-                net.disconnect(); // stop networking now to save power
+                rootLogger.error("Template mode needs a frame buffer");
+            } else {
+                displayTemplate(pPanel);
             }
+        } else {
+            // get new image
+            auto httpImageClient = HttpClient(/*debug*/ false);
+            httpImageClient.startRequest("GET", base_url + "epaper/api/displays/" + net.getDeviceId() + "/image", "", "abc"/*etag.get()*/); // TODO REMOVE ME
 
-            // create pixel buffers from png and display them
-            String png = httpImageClient.getResponseText();
-            auto pb = PixelBuffer(pPanel->getWidth(), pPanel->getHeight(), pPanel->getBitsPerChannel());
+            // Wait for image data...
+            httpImageClient.waitForCompletionUntil(bootTimestamp + 5000);
+            updateInterval_s = httpImageClient.getResponseMaxAgeSeconds(updateInterval_s);
+            syncClock(httpImageClient.getResponseDate());
+            //httpImageClient.log();
 
-            if (pb.prepareBufForPng((unsigned char*)httpImageClient.getResponseText().c_str(), png.length()))
+            // Display the image
+            if ( httpImageClient.isResponseLengthOk() && httpImageClient.getResponseCode() == 200 )
             {
-                auto channelColors = pPanel->getChannelRgbColors();
-                for (int channelNo = 0; channelNo < channelColors.size(); channelNo++)
+                // shut down networking if not longer needed - might destrpy response code
+                if ( statusRequest.readyState() == 4 && extraPanelCount == 0 )
+                {
+                    net.disconnect(); // stop networking now to save power
+                    setPanelLightSleep(/*isWifiOff*/ true);
+                }
+
+                // the further panels are transferred while this one refreshes
+                isRefreshDeferred = extraPanelCount > 0 && !MemoryPlanner::isStreaming();
+                if (displayResponse(httpImageClient.getResponseText(), httpImageClient.getResponseHeader("Content-Type"), pPanel))
                 {
-                    auto colorTuple = channelColors[channelNo];
-                    //rootLogger.info("colorTuple=%d/%d/%d", std::get<0>(colorTuple), std::get<1>(colorTuple), std::get<2>(colorTuple));
-                    pb.writePngChannelToBuffer( colorTuple );
-                    delay(1); // satisfy the task watchdog
-                    pb.drawBattery(pPanel->getWidth() - 22 - 5, 5, /*color*/pPanel->getDefaultColor(channelNo), battery.getVoltage_mV(), battery.getPercentage());
-                    pb.drawWiFi(pPanel->getWidth() - 22 - 5 - 14 - 5, 5, /*color*/pPanel->getDefaultColor(channelNo), net.getRSSI());
-                    // pb.setTextColor(pPanel->getDefaultColor(channelNo));
-                    // pb.setTextSize(3);
-                    // pb.setCursor(50, 5); pb.printf("Test %d", bootCount);
-                    //pPanel->writeChannel(channelNo, pb.getBufPtr());  // PANEL
-                    epd.displayPixelBuffer(pb.getBufPtr());  // EPD
-                    delay(1); // satisfy the task watchdog
+                    etag.set(httpImageClient.getResponseHeader("ETag"));
                 }
-                etag.set(httpImageClient.getResponseHeader("ETag"));
-                //pPanel->display(); // PANEL
             } else {
-                rootLogger.error("Error creating Pixel Buffer");
+                rootLogger.debug("HTTP Response code %d != 200, nothing to display!", httpImageClient.getResponseCode());
             }
-        } else {
-            rootLogger.debug("HTTP Response code %d != 200, nothing to display!", httpImageClient.getResponseCode());
+            if (extraPanelCount > 0 && !MemoryPlanner::isStreaming())
+            {
+                isRefreshDeferred = true;
+                displayExtraPanels();
+                // all images are downloaded, the refreshes are waited for without WiFi
+                if (statusRequest.readyState() == 4)
+                {
+                    net.disconnect();
+                    setPanelLightSleep(/*isWifiOff*/ true);
+                }
+            }
+            finishRefreshes();
         }
         // TODO httpStatusReporter.waitForCompletionUntil(bootTimestamp + 5000);
-        epd.stop(); // EPD
-        //pPanel->deep_sleep(); // PANEL
     } else {
         // no network connection
     }
 
     // shutdown
-    net.disconnect();
-    sleepDuration_ms = bootTimestamp + updateInterval_s * 1000l - millis();
-    if (sleepDuration_ms < min_update_interval_s*1000l)
-    {
-        sleepDuration_ms = min_update_interval_s*1000l;
-    }
-    activeDuration_ms = millis() - bootTimestamp;
-    rootLogger.info("System was awake for %.3f s", activeDuration_ms / 1000.0);
-    rootLogger.info("System entering deep sleep state for %.3f s...", sleepDuration_ms / 1000.0);
-    digitalWrite(BUILTIN_LED, LOW);
-    esp_sleep_enable_timer_wakeup(sleepDuration_ms * 1000LL);
-    esp_deep_sleep_start();
+    enterDeepSleep(/*isNetworkWake*/ true);
 }
 
 // ***************************************************************************
@@ -6,15 +6,44 @@
 #pragma once
 
 #include <Arduino.h>
-#include <GxEPD2_EPD.h>
-// specific display drivers for 4.2" 400x300 bw and 7.5" 880x528 red/black/white
-#include <epd/GxEPD2_420.h>
-#include <epd3c/GxEPD2_750c_Z90.h>
 
 const char* WIFI_SSID = "My WiFi SSID";
 const char* WIFI_PASSWORD = "My WiFi Password!";
 const String base_url = "http://192.168.178.20:9830/";
 
+// Panel name as listed in PANEL_DESCRIPTORS (Panel.cpp), e.g. "Waveshare-042bw" or
+// "Waveshare-042gray".
+const char* EPD_PANEL_NAME = "Waveshare-042bw";
+
+// Quarter turns for portrait mounted panels (0..3, as Adafruit_GFX::setRotation()).
+// The image is rendered in the rotated orientation and rotated as a whole.
+const int EPD_ROTATION = 0;
+
+// Template mode: keep the background image in flash and fetch it only if its
+// version changed, fetch a small JSON layout with the current values instead.
+const bool EPD_TEMPLATE_MODE = false;
+
+// Decode PNG images band by band straight to the panel instead of into a frame
+// buffer. Requires EPD_ROTATION = 0. Used automatically if the frame does not
+// fit into memory.
+const bool EPD_STREAM_PNG = false;
+
+// Local clock: wake every EPD_CLOCK_INTERVAL_S seconds with WiFi off and update
+// a clock in the top left corner of the last frame with a partial refresh. The
+// network is used only at the max-age interval of the server. Until the time
+// is known from the HTTP Date header, the age of the data is shown in minutes.
+// 0 disables the clock. EPD_TIMEZONE is a POSIX TZ string.
+const unsigned long EPD_CLOCK_INTERVAL_S = 0;
+const char* EPD_TIMEZONE = "CET-1CEST,M3.5.0,M10.5.0/3";
+
+// Light sleep while the panel refreshes instead of waiting awake for BUSY.
+const bool EPD_LIGHT_SLEEP = true;
+
+// Full refreshes with the fast waveform (about half the time) on panels which
+// have one. A clean slow refresh is forced after a number of fast refreshes or
+// a time limit, the ghosting budget of the panel type.
+const bool EPD_FAST_REFRESH = false;
+
 const unsigned long default_update_interval_s = 30 * 60;
 const unsigned long min_update_interval_s = 30;
 
@@ -25,3 +54,14 @@ const int EPD_CS = 15;
 const int EPD_DC = 27;
 const int EPD_RST = 26;
 const int EPD_BUSY = 25;
+
+// Further panels on the same SPI bus: SCK and MOSI are shared, CS, RST and
+// BUSY are separate, DC may be shared. Requires -DNATIVE_PANEL and a frame
+// buffer. Panel n (the panel above is 0) shows ".../image?panel=n". All
+// frames are transferred before the first refresh completes, so the
+// refreshes run at the same time. Up to 4 further panels.
+struct EpdPanelConfig { const char *name; int cs; int dc; int rst; int busy; };
+const int EPD_EXTRA_PANEL_COUNT = 0;
+const EpdPanelConfig EPD_EXTRA_PANELS[] = {
+    { "Waveshare-042bw", /*cs*/ 4, /*dc*/ EPD_DC, /*rst*/ 5, /*busy*/ 18 },
+};
@@ -0,0 +1,61 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// Adafruit_GFX subset for the host tests: rotation and the rectangle
+// primitives as in the library, text is not rendered.
+
+#include <Arduino.h>
+
+struct GFXfont;
+
+class Adafruit_GFX
+{
+public:
+    Adafruit_GFX(int16_t w, int16_t h): WIDTH(w), HEIGHT(h), _width(w), _height(h), rotation(0) {}
+    virtual ~Adafruit_GFX() {}
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+    {
+        for (int16_t j = y; j < y + h; j++)
+            for (int16_t i = x; i < x + w; i++)
+                drawPixel(i, j, color);
+    }
+    virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { fillRect(x, y, w, 1, color); }
+    virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { fillRect(x, y, 1, h, color); }
+    virtual void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+
+    void setRotation(uint8_t r)
+    {
+        rotation = r & 3;
+        _width = (rotation & 1) ? HEIGHT : WIDTH;
+        _height = (rotation & 1) ? WIDTH : HEIGHT;
+    }
+    uint8_t getRotation() const { return rotation; }
+    int16_t width() const { return _width; }
+    int16_t height() const { return _height; }
+
+    void setCursor(int16_t x, int16_t y) {}
+    void setTextColor(uint16_t color) {}
+    void setTextColor(uint16_t color, uint16_t background) {}
+    void setTextSize(uint8_t size) {}
+    void setTextWrap(bool isWrapping) {}
+    void setFont(const GFXfont *font = nullptr) {}
+    void getTextBounds(const char *text, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h)
+    {
+        *x1 = x;
+        *y1 = y;
+        *w = 0;
+        *h = 0;
+    }
+    size_t print(const char *text) { return 0; }
+
+protected:
+    const int16_t WIDTH, HEIGHT;
+    int16_t _width, _height;
+    uint8_t rotation;
+};
@@ -0,0 +1,36 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// Arduino core subset for the host tests (env:native). Pins do nothing,
+// time stands still: busy times come from the SimulatedController.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define RISING 1
+#define FALLING 2
+
+#define IRAM_ATTR
+
+inline void pinMode(int pin, int mode) {}
+inline void digitalWrite(int pin, int level) {}
+inline int digitalRead(int pin) { return LOW; }
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterruptArg(int interrupt, void (*isr)(void *), void *arg, int mode) {}
+inline void detachInterrupt(int interrupt) {}
+
+inline void delay(uint32_t ms) {}
+inline unsigned long millis() { return 0; }
+inline unsigned long micros() { return 0; }
@@ -0,0 +1,29 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// GxEPD2::Panel of the GxEPD2 library, the panels of PANEL_DESCRIPTORS only
+
+class GxEPD2
+{
+public:
+    enum Panel
+    {
+        GDEW042T2, Waveshare_4_2_bw = GDEW042T2,
+        GDEW042M01,
+        GDEW0583T7, Waveshare_5_83_bw = GDEW0583T7,
+        GDEW0583T8,
+        GDEW075T8, Waveshare_7_5_bw = GDEW075T8,
+        GDEW075T7, Waveshare_7_5_bw_T7 = GDEW075T7,
+        GDEW1248T3, Waveshare_12_24_bw = GDEW1248T3,
+        GDEW042Z15, Waveshare_4_2_bwr = GDEW042Z15,
+        GDEW0583Z21, Waveshare_5_83_bwr = GDEW0583Z21,
+        ACeP565, Waveshare_5_65_7c = ACeP565,
+        GDEW075Z09, Waveshare_7_5_bwr = GDEW075Z09,
+        GDEW075Z08, Waveshare_7_5_bwr_Z08 = GDEW075Z08,
+        GDEH075Z90, Waveshare_7_5_bwr_Z90 = GDEH075Z90
+    };
+};
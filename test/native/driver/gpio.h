@@ -0,0 +1,18 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// ESP-IDF GPIO driver for the host tests, gpio_set_level() is implemented
+// by the mock transport of test/test_spi_transfer (DC pin)
+
+#include <stdint.h>
+
+typedef int gpio_num_t;
+typedef enum { GPIO_INTR_LOW_LEVEL = 4, GPIO_INTR_HIGH_LEVEL = 5 } gpio_int_type_t;
+
+int gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+inline int gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type) { return 0; }
+inline int gpio_wakeup_disable(gpio_num_t gpio_num) { return 0; }
@@ -0,0 +1,21 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// ESP-IDF heap capabilities for the host tests: a single heap
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT 0x04
+#define MALLOC_CAP_DMA 0x08
+#define MALLOC_CAP_INTERNAL 0x800
+#define MALLOC_CAP_SPIRAM 0x400
+
+inline void *heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+inline void heap_caps_free(void *ptr) { free(ptr); }
+inline size_t heap_caps_get_free_size(uint32_t caps) { return 0; }
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return 0; }
@@ -0,0 +1,16 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// ESP-IDF logging for the host tests: errors and warnings go to stderr
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, ...) fprintf(stderr, __VA_ARGS__), fputc('\n', stderr)
+#define ESP_LOGW(tag, ...) fprintf(stderr, __VA_ARGS__), fputc('\n', stderr)
+#define ESP_LOGI(tag, ...) ((void) 0)
+#define ESP_LOGD(tag, ...) ((void) 0)
+#define ESP_LOGV(tag, ...) ((void) 0)
@@ -0,0 +1,17 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// ESP-IDF sleep functions for the host tests, the SoC never sleeps
+
+#include <stdint.h>
+
+typedef enum { ESP_SLEEP_WAKEUP_TIMER = 4, ESP_SLEEP_WAKEUP_GPIO = 7 } esp_sleep_source_t;
+
+inline int esp_sleep_enable_gpio_wakeup() { return 0; }
+inline int esp_sleep_enable_timer_wakeup(uint64_t time_in_us) { return 0; }
+inline int esp_light_sleep_start() { return 0; }
+inline int esp_sleep_disable_wakeup_source(esp_sleep_source_t source) { return 0; }
@@ -0,0 +1,12 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) { return 0; }
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *isWoken) {}
@@ -0,0 +1,22 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+// Interface of the logger32 library as far as the host tests need it
+
+class Logger
+{
+public:
+    Logger(const char *name, const Logger& parent) {}
+    Logger(const char *name, void *handler) {}
+
+    template<typename... Args> void debug(const char *format, Args... args) const {}
+    template<typename... Args> void info(const char *format, Args... args) const {}
+    template<typename... Args> void warning(const char *format, Args... args) const {}
+    template<typename... Args> void error(const char *format, Args... args) const {}
+};
+
+extern Logger rootLogger;
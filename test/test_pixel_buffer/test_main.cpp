@@ -0,0 +1,111 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+// Frame buffer layout and hash, run with: pio test -e native_frame
+
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "MemoryPlanner.h"
+#include "PixelBuffer.h"
+
+Logger rootLogger("root", nullptr);
+
+/// content of freshly allocated scratch buffers, as left over on the heap
+static uint8_t scratchFill = 0;
+
+void* MemoryPlanner::allocate(Buffer buffer, size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr != nullptr && buffer == ROTATION)
+        memset(ptr, scratchFill, size);
+    return ptr;
+}
+
+void MemoryPlanner::release(Buffer buffer, void *ptr)
+{
+    free(ptr);
+}
+
+// ***************************************************************************
+
+// 4.2" panel: 90 degrees give a logical plane of 38 x 400 B, the panel plane is 50 x 300 B
+static const int WIDTH = 400;
+static const int HEIGHT = 300;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static const PixelBuffer::RgbColors WHITE_RED = {
+    std::make_tuple(255, 255, 255), std::make_tuple(255, 0, 0)
+};
+
+/// Rotated frame with a few black pixels and a red line, scratch as given
+static uint64_t hashRotatedFrame(int rotation, uint8_t fill)
+{
+    scratchFill = fill;
+    PixelBuffer pb(WIDTH, HEIGHT, 1, 2);
+    pb.setPlaneColors(WHITE_RED);
+    pb.setFrameRotation(rotation);
+    TEST_ASSERT_TRUE(pb.allocateBuf());
+    pb.selectPlane(0);
+    pb.drawPixel(0, 0, 0);
+    pb.drawPixel(17, 333, 0);
+    pb.selectPlane(1);
+    pb.drawFastHLine(10, 20, 100, 1);
+    TEST_ASSERT_TRUE(pb.rotateToPanel());
+
+    // the padding of the logical layout beyond the panel rows is cleared
+    const size_t panelPlaneSize = HEIGHT * WIDTH / 8;
+    for (int plane = 0; plane < pb.getPlanes(); plane++)
+    {
+        for (size_t i = panelPlaneSize; i < pb.getPlaneSize(); i++)
+            TEST_ASSERT_EQUAL_UINT8(0, pb.getBufPtr(plane)[i]);
+    }
+    return pb.getHash();
+}
+
+void test_rotated_hash_ignores_scratch()
+{
+    for (int rotation : { 1, 3 })
+    {
+        TEST_ASSERT_TRUE(hashRotatedFrame(rotation, 0x00) == hashRotatedFrame(rotation, 0xa5));
+        TEST_ASSERT_TRUE(hashRotatedFrame(rotation, 0xff) == hashRotatedFrame(rotation, 0x3c));
+    }
+    TEST_ASSERT_TRUE(hashRotatedFrame(1, 0) != hashRotatedFrame(3, 0));
+}
+
+/// The hash covers the pixels of every plane
+void test_hash_covers_all_planes()
+{
+    PixelBuffer pb(WIDTH, HEIGHT, 1, 2);
+    pb.setPlaneColors(WHITE_RED);
+    TEST_ASSERT_TRUE(pb.allocateBuf());
+    const uint64_t white = pb.getHash();
+
+    pb.selectPlane(1);
+    pb.drawPixel(WIDTH - 1, HEIGHT - 1, 1);
+    const uint64_t red = pb.getHash();
+    TEST_ASSERT_TRUE(red != white);
+
+    pb.drawPixel(WIDTH - 1, HEIGHT - 1, 0);
+    TEST_ASSERT_TRUE(pb.getHash() == white);
+}
+
+// ***************************************************************************
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rotated_hash_ignores_scratch);
+    RUN_TEST(test_hash_covers_all_planes);
+    return UNITY_END();
+}
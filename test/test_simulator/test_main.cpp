@@ -0,0 +1,398 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+// Panel drivers and their scripts against the SimulatedController,
+// run with: pio test -e native
+
+#include <stdlib.h>
+#include <vector>
+#include <unity.h>
+
+#include "MemoryPlanner.h"
+#include "Panel.h"
+#include "PanelInterface.h"
+#include "RefreshPlanner.h"
+#include "SimulatedController.h"
+
+Logger rootLogger("root", nullptr);
+
+void* MemoryPlanner::allocate(Buffer buffer, size_t size)
+{
+    return malloc(size);
+}
+
+void MemoryPlanner::release(Buffer buffer, void *ptr)
+{
+    free(ptr);
+}
+
+// ***************************************************************************
+
+static SimulatedController *sim;
+static PanelInterface *pIf;
+
+static const int WIDTH = 400;
+static const int HEIGHT = 300;
+static const int STRIDE = WIDTH / 8;
+
+void setUp()
+{
+    sim = new SimulatedController(WIDTH, HEIGHT);
+    pIf = new PanelInterface(13, 16, 14, 15, 27, 26, 25);
+    pIf->attachSimulation(sim);
+    pIf->init();
+}
+
+void tearDown()
+{
+    delete pIf;
+    delete sim;
+}
+
+static Panel *createPanel(const char *name)
+{
+    const PanelDescriptor *descriptor = PanelDescriptor::find(name);
+    TEST_ASSERT_NOT_NULL(descriptor);
+    Panel *panel = descriptor->create(*descriptor);
+    panel->init(pIf);
+    return panel;
+}
+
+/// White frame with a black rectangle, x0 and x1 in bytes
+static std::vector<uint8_t> makeFrame(int x0, int y0, int x1, int y1, uint8_t value = 0x00)
+{
+    std::vector<uint8_t> frame(STRIDE * HEIGHT, 0xff);
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++)
+            frame[y * STRIDE + x] = value;
+    return frame;
+}
+
+// ***************************************************************************
+
+void test_full_refresh_shows_frame()
+{
+    Panel *panel = createPanel("Waveshare-042bw");
+    const std::vector<uint8_t> frame = makeFrame(10, 100, 20, 200);
+    panel->writeChannel(0, frame.data());
+    panel->display();
+
+    const uint8_t resolution[] = { 0x01, 0x90, 0x01, 0x2c };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(resolution, sim->getRegister(0x61).data(), sizeof(resolution));
+    TEST_ASSERT_TRUE(sim->getDisplay() == frame);
+    TEST_ASSERT_TRUE(sim->getOldRam() == std::vector<uint8_t>(STRIDE * HEIGHT, 0xff));
+    TEST_ASSERT_EQUAL_UINT32(1, sim->getStats().refreshes);
+    TEST_ASSERT_EQUAL_UINT32(0, sim->getStats().ignoredBytes);
+    delete panel;
+}
+
+void test_deep_sleep_ignores_traffic()
+{
+    Panel *panel = createPanel("Waveshare-042bw");
+    panel->deep_sleep();
+    TEST_ASSERT_TRUE(sim->isSleeping());
+
+    pIf->writeCommand(0x13);
+    pIf->writeData((uint8_t) 0xff, 10);
+    TEST_ASSERT_EQUAL_UINT32(11, sim->getStats().ignoredBytes);
+    delete panel;
+}
+
+/// Window rounded to bytes, old and new data RAM written inside it only
+void test_partial_refresh_window()
+{
+    Panel *panel = createPanel("Waveshare-042bw");
+    const std::vector<uint8_t> previous = makeFrame(0, 0, 0, 0);
+    panel->writeChannel(0, previous.data());
+    panel->display();
+
+    const DiffRect rect = { 13, 7, 30, 20 };
+    const std::vector<uint8_t> current = makeFrame(1, 7, 6, 27, 0x0f);
+    panel->displayPartial(previous.data(), current.data(), rect);
+
+    // x 8..47 inclusive, y 7..26
+    const uint8_t window[] = { 0x00, 0x08, 0x00, 0x2f, 0x00, 0x07, 0x00, 0x1a, 0x01 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(window, sim->getRegister(0x90).data(), sizeof(window));
+    TEST_ASSERT_EQUAL_UINT32(1, sim->getStats().partialRefreshes);
+    TEST_ASSERT_TRUE(sim->getDisplay() == current);
+    TEST_ASSERT_TRUE(sim->getNewRam() == current);
+    TEST_ASSERT_TRUE(sim->getOldRam() == previous);
+
+    // panel setting, VCOM and border of the full waveform are restored
+    const uint8_t panelSetting[] = { 0xbf, 0x0d };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(panelSetting, sim->getRegister(0x00).data(), sizeof(panelSetting));
+    TEST_ASSERT_EQUAL_UINT8(0x28, sim->getRegister(0x82)[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x97, sim->getRegister(0x50)[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x02, sim->getRegister(0x20)[5]);
+
+    // partial out restores the full frame for the next full refresh
+    const std::vector<uint8_t> next = makeFrame(40, 200, 50, 300);
+    panel->writeChannel(0, next.data());
+    panel->display();
+    TEST_ASSERT_TRUE(sim->getDisplay() == next);
+    delete panel;
+}
+
+/// UC8179: window in the OTP partial waveform, temperature and border restored without a power on
+void test_uc8179_partial_refresh_restores()
+{
+    Panel *panel = createPanel("GDEW075T7/Waveshare_7_5_bw_T7");
+    const int stride = 800 / 8;
+    const std::vector<uint8_t> previous(stride * 480, 0xff);
+    std::vector<uint8_t> current = previous;
+    for (int y = 100; y < 110; y++)
+        current[y * stride + 50] = 0x00;
+    panel->writeChannel(0, previous.data());
+    panel->display();
+
+    sim->resetStats();
+    const DiffRect rect = { 400, 100, 8, 10 };
+    panel->displayPartial(previous.data(), current.data(), rect);
+
+    const uint8_t window[] = { 0x01, 0x90, 0x01, 0x97, 0x00, 0x64, 0x00, 0x6d, 0x01 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(window, sim->getRegister(0x90).data(), sizeof(window));
+    TEST_ASSERT_EQUAL_UINT32(1, sim->getStats().partialRefreshes);
+    // black and white RAM inverted: 0 is white
+    TEST_ASSERT_EQUAL_UINT8(0xff, sim->getNewRam()[105 * stride + 50]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, sim->getNewRam()[105 * stride + 51]);
+    // one byte per row and RAM
+    TEST_ASSERT_EQUAL_UINT32(4 + sizeof(window) + 10 + 10 + 3, sim->getStats().dataBytes);
+
+    TEST_ASSERT_EQUAL_UINT8(0x00, sim->getRegister(0xe0)[0]);
+    const uint8_t border[] = { 0x10, 0x07 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(border, sim->getRegister(0x50).data(), sizeof(border));
+    // script, window, old and new RAM, refresh, partial out, restore
+    TEST_ASSERT_EQUAL_UINT32(4 + 1 + 2 + 1 + 1 + 2, sim->getStats().commandBytes);
+    delete panel;
+}
+
+/// The fast script forces the temperature of the fast OTP waveform before the refresh
+void test_uc8179_fast_refresh()
+{
+    Panel *panel = createPanel("GDEW075T7/Waveshare_7_5_bw_T7");
+    panel->setRefreshMode(Panel::REFRESH_FAST);
+    panel->display();
+
+    TEST_ASSERT_EQUAL_UINT8(0x02, sim->getRegister(0xe0)[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x5a, sim->getRegister(0xe5)[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, sim->getStats().refreshes);
+    delete panel;
+}
+
+/// A window set without partial mode does not restrict RAM writes
+void test_ram_write_outside_partial_mode()
+{
+    const uint8_t window[] = { 0x00, 0x08, 0x00, 0x2f, 0x00, 0x07, 0x00, 0x1a, 0x01 };
+    const std::vector<uint8_t> frame = makeFrame(0, 0, 25, 150);
+    pIf->writeCommand(0x90, window, sizeof(window));
+    pIf->writeCommand(0x13, frame.data(), frame.size());
+    TEST_ASSERT_TRUE(sim->getNewRam() == frame);
+    TEST_ASSERT_EQUAL_UINT32(0, sim->getStats().ignoredBytes);
+}
+
+/// 2 bpp pixels split into the high bit (old RAM) and the low bit (new RAM)
+void test_grey_planes()
+{
+    Panel *panel = createPanel("Waveshare-042gray");
+    // pixel levels 0, 1, 2, 3 repeated: 0b00011011
+    const std::vector<uint8_t> frame(2 * STRIDE * HEIGHT, 0x1b);
+    panel->writeChannel(0, frame.data());
+
+    TEST_ASSERT_TRUE(sim->getOldRam() == std::vector<uint8_t>(STRIDE * HEIGHT, 0x33));
+    TEST_ASSERT_TRUE(sim->getNewRam() == std::vector<uint8_t>(STRIDE * HEIGHT, 0x55));
+    delete panel;
+}
+
+/// Black and white plane to the old RAM, red plane inverted to the new RAM
+void test_black_white_red_planes()
+{
+    Panel *panel = createPanel("GDEW042Z15/Waveshare_4_2_bwr");
+    const std::vector<uint8_t> white = makeFrame(10, 100, 20, 200);
+    const std::vector<uint8_t> red = makeFrame(0, 0, 5, 5, 0xff);
+    std::vector<uint8_t> redRam(red.size());
+    for (size_t i = 0; i < red.size(); i++)
+        redRam[i] = ~red[i];
+    panel->writeChannel(0, white.data());
+    panel->writeChannel(1, red.data());
+
+    TEST_ASSERT_TRUE(sim->getOldRam() == white);
+    TEST_ASSERT_TRUE(sim->getNewRam() == redRam);
+    delete panel;
+}
+
+/// 4 bpp colour codes: black, the last channel with a set bit wins, white pairs are 0x33
+void test_pixel_ram_code_merge()
+{
+    Panel *panel = createPanel("GDEW0583Z21/Waveshare_5_83_bwr");
+    const int stride = 600 / 8;
+    std::vector<uint8_t> white(stride * 448, 0xff);
+    std::vector<uint8_t> red(stride * 448, 0x00);
+    white[10 * stride] = 0x0f;
+    red[20 * stride + 1] = 0xf0;
+    red[30 * stride] = 0x80;
+    white[30 * stride] = 0x7f;
+    sim->resetStats();
+    panel->writeChannel(0, white.data());
+    // buffered until the last channel
+    TEST_ASSERT_EQUAL_UINT32(0, sim->getStats().dataBytes);
+    panel->writeChannel(1, red.data());
+
+    const int rowBytes = 600 / 2;
+    const std::vector<uint8_t>& ram = sim->getRegister(0x10);
+    TEST_ASSERT_EQUAL_UINT32(rowBytes * 448, ram.size());
+    TEST_ASSERT_EQUAL_UINT8(0x33, ram[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, ram[10 * rowBytes]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, ram[10 * rowBytes + 1]);
+    TEST_ASSERT_EQUAL_UINT8(0x33, ram[10 * rowBytes + 2]);
+    TEST_ASSERT_EQUAL_UINT8(0x44, ram[20 * rowBytes + 4]);
+    TEST_ASSERT_EQUAL_UINT8(0x44, ram[20 * rowBytes + 5]);
+    TEST_ASSERT_EQUAL_UINT8(0x33, ram[20 * rowBytes + 6]);
+    // red over black
+    TEST_ASSERT_EQUAL_UINT8(0x43, ram[30 * rowBytes]);
+    TEST_ASSERT_EQUAL_UINT32(rowBytes * 448, sim->getStats().dataBytes);
+    delete panel;
+}
+
+/// Six channels: the last one with a set bit gives the colour code
+void test_pixel_ram_last_channel_order()
+{
+    Panel *panel = createPanel("ACeP565/Waveshare_5_65_7c");
+    const int stride = 600 / 8;
+    const std::vector<uint8_t> empty(stride * 448, 0x00);
+    std::vector<uint8_t> green = empty;
+    std::vector<uint8_t> blue = empty;
+    green[0] = 0xc0;
+    blue[0] = 0x40;
+    panel->writeChannel(0, empty.data());
+    panel->writeChannel(1, green.data());
+    panel->writeChannel(2, blue.data());
+    for (int channel = 3; channel < 6; channel++)
+        panel->writeChannel(channel, empty.data());
+
+    // pixel 0 green (code 2), pixel 1 green and blue (code 3), then black
+    const std::vector<uint8_t>& ram = sim->getRegister(0x10);
+    TEST_ASSERT_EQUAL_UINT32(300 * 448, ram.size());
+    TEST_ASSERT_EQUAL_UINT8(0x23, ram[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, ram[1]);
+    delete panel;
+}
+
+/// Both planes streamed as is, the counters reset to the top row before each
+void test_ssd1677_planes()
+{
+    // 0x12 is a software reset, no UC81xx refresh
+    sim->setBusyModel(0, 0, 0, 0);
+    Panel *panel = createPanel("GDEH075Z90/Waveshare_7_5_bwr_Z90");
+    const int stride = 880 / 8;
+    std::vector<uint8_t> white(stride * 528, 0xff);
+    std::vector<uint8_t> red(stride * 528, 0x00);
+    white[100 * stride + 5] = 0x00;
+    red[200 * stride + 7] = 0x3c;
+    sim->resetStats();
+    panel->writeChannel(0, white.data());
+    panel->writeChannel(1, red.data());
+    panel->display();
+
+    TEST_ASSERT_TRUE(sim->getRegister(0x24) == white);
+    TEST_ASSERT_TRUE(sim->getRegister(0x26) == red);
+    const uint8_t y_counter[] = { 0xaf, 0x02 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(y_counter, sim->getRegister(0x4f).data(), sizeof(y_counter));
+    TEST_ASSERT_EQUAL_UINT8(0xc7, sim->getRegister(0x22)[0]);
+    // counters and planes
+    TEST_ASSERT_EQUAL_UINT32(2 * (2 + 2 + stride * 528) + 1, sim->getStats().dataBytes);
+    delete panel;
+}
+
+void test_script_opcodes()
+{
+    const uint8_t script[] = {
+        PanelInterface::SCRIPT_CMD, 0x50, 2, 0x97, 0x07,
+        PanelInterface::SCRIPT_FILL, 0x10, 0x00, 0x10, 0x27, 0x00, 0x00,   // 10000 bytes
+        PanelInterface::SCRIPT_DELAY, 0x64, 0x00,
+        PanelInterface::SCRIPT_CMD, 0x04, 0,
+        PanelInterface::SCRIPT_WAIT_BUSY, LOW, 0xe8, 0x03,
+        PanelInterface::SCRIPT_END
+    };
+    TEST_ASSERT_TRUE(pIf->runScript(script));
+
+    const uint8_t vcom[] = { 0x97, 0x07 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(vcom, sim->getRegister(0x50).data(), sizeof(vcom));
+    TEST_ASSERT_EQUAL_UINT8(0x00, sim->getOldRam()[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, sim->getOldRam()[9999]);
+    TEST_ASSERT_EQUAL_UINT8(0xff, sim->getOldRam()[10000]);
+    TEST_ASSERT_EQUAL_UINT32(3, sim->getStats().commandBytes);
+    TEST_ASSERT_EQUAL_UINT32(2 + 10000, sim->getStats().dataBytes);
+    TEST_ASSERT_EQUAL_UINT32(80, pIf->getBusyDuration_ms(0x04));
+
+    const uint8_t unknown[] = { 0x7f, PanelInterface::SCRIPT_END };
+    TEST_ASSERT_FALSE(pIf->runScript(unknown));
+}
+
+/// Refresh longer than the timeout of the descriptor
+void test_busy_timeout()
+{
+    Panel *panel = createPanel("GDEW042M01");
+    sim->setBusyModel(80, 20, 12000, 600);
+    panel->startDisplay();
+    TEST_ASSERT_FALSE(panel->waitDisplay());
+
+    sim->setBusyModel(80, 20, 4000, 600);
+    panel->startDisplay();
+    TEST_ASSERT_TRUE(panel->waitDisplay());
+    delete panel;
+}
+
+/// A zeroed history (RTC memory after power on) has no clean refresh to build on
+void test_planner_cold_history()
+{
+    Panel *panel = createPanel("Waveshare-042bw");
+    RefreshPlanner planner(*panel, true, false, rootLogger);
+    const std::vector<uint8_t> previous = makeFrame(0, 0, 0, 0);
+    const std::vector<uint8_t> current = makeFrame(1, 7, 6, 27);
+    FrameDiff diff(WIDTH, HEIGHT, 1);
+    diff.compare(current.data(), previous.data());
+    const time_t now = 1000;
+
+    RefreshPlanner::History history = {};
+    TEST_ASSERT_EQUAL(RefreshPlanner::FULL, planner.plan(diff, history, now).mode);
+    TEST_ASSERT_EQUAL(RefreshPlanner::FULL, planner.planFull(history, now).mode);
+
+    RefreshPlanner::record(planner.plan(diff, history, now), history, now);
+    TEST_ASSERT_EQUAL(RefreshPlanner::PARTIAL, planner.plan(diff, history, now + 60).mode);
+    TEST_ASSERT_EQUAL(RefreshPlanner::FAST, planner.planFull(history, now + 60).mode);
+    delete panel;
+}
+
+/// Renamed panels are still found by their former name
+void test_panel_alias()
+{
+    const PanelDescriptor *descriptor = PanelDescriptor::find("Waveshare-042bw");
+    TEST_ASSERT_NOT_NULL(descriptor);
+    TEST_ASSERT_EQUAL_PTR(descriptor, PanelDescriptor::find("GDEW042T2/Waveshare_4_2_bw"));
+    TEST_ASSERT_NULL(PanelDescriptor::find("GDEW042T2"));
+}
+
+// ***************************************************************************
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_full_refresh_shows_frame);
+    RUN_TEST(test_deep_sleep_ignores_traffic);
+    RUN_TEST(test_partial_refresh_window);
+    RUN_TEST(test_uc8179_partial_refresh_restores);
+    RUN_TEST(test_uc8179_fast_refresh);
+    RUN_TEST(test_ram_write_outside_partial_mode);
+    RUN_TEST(test_grey_planes);
+    RUN_TEST(test_black_white_red_planes);
+    RUN_TEST(test_pixel_ram_code_merge);
+    RUN_TEST(test_pixel_ram_last_channel_order);
+    RUN_TEST(test_ssd1677_planes);
+    RUN_TEST(test_script_opcodes);
+    RUN_TEST(test_busy_timeout);
+    RUN_TEST(test_planner_cold_history);
+    RUN_TEST(test_panel_alias);
+    return UNITY_END();
+}
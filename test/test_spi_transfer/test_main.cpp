@@ -0,0 +1,314 @@
+/**
+ * ESP32 E-Paper display firmware
+ * Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+ */
+
+// Chunking of PanelInterface bulk transfers against a mock spi_master
+// transport, run with: pio test -e native_spi
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <set>
+#include <vector>
+#include <unity.h>
+#include <driver/gpio.h>
+#include <driver/spi_master.h>
+
+#include "MemoryPlanner.h"
+#include "PanelInterface.h"
+
+Logger rootLogger("root", nullptr);
+
+static int transferAllocations = 0;
+
+void* MemoryPlanner::allocate(Buffer buffer, size_t size)
+{
+    if (buffer == TRANSFER)
+        transferAllocations++;
+    return malloc(size);
+}
+
+void MemoryPlanner::release(Buffer buffer, void *ptr)
+{
+    free(ptr);
+}
+
+// ***************************************************************************
+
+/**
+ * Mock transport: a queued transaction is transmitted when its result is
+ * fetched, the latest moment the hardware could read it, and compared with
+ * its content when it was queued. A transfer buffer reused too early shows
+ * up as overwritten.
+ */
+struct MockBus
+{
+    struct Pending
+    {
+        spi_transaction_t *trans;
+        std::vector<uint8_t> bytes;
+    };
+
+    spi_device_interface_config_t config;
+    std::deque<Pending> pending;
+    int dc_level;
+
+    std::vector<uint8_t> commands;
+    std::vector<uint8_t> data;
+    std::vector<size_t> chunks;             //< data transaction sizes
+    std::set<const void *> chunkBuffers;    //< payloads of data transactions > SLOT_SIZE
+    int transactions;
+    int overwritten;
+    int overflows;
+
+    void clear()
+    {
+        commands.clear();
+        data.clear();
+        chunks.clear();
+        chunkBuffers.clear();
+        transactions = 0;
+        overwritten = 0;
+        overflows = 0;
+    }
+};
+
+static MockBus bus;
+static spi_device_t *const DEVICE = (spi_device_t *) &bus;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config, int dma_chan)
+{
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config, spi_device_handle_t *handle)
+{
+    bus.config = *dev_config;
+    *handle = DEVICE;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t ticks_to_wait)
+{
+    if ((int) bus.pending.size() >= bus.config.queue_size)
+    {
+        bus.overflows++;
+        return ESP_FAIL;
+    }
+    const uint8_t *bytes = (const uint8_t *) trans->tx_buffer;
+    bus.pending.push_back({ trans, std::vector<uint8_t>(bytes, bytes + trans->length / 8) });
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans, TickType_t ticks_to_wait)
+{
+    if (bus.pending.empty())
+        return ESP_FAIL;
+    const MockBus::Pending p = bus.pending.front();
+    bus.pending.pop_front();
+
+    bus.config.pre_cb(p.trans);
+    const uint8_t *bytes = (const uint8_t *) p.trans->tx_buffer;
+    const size_t numBytes = p.trans->length / 8;
+    if (numBytes != p.bytes.size() || memcmp(bytes, p.bytes.data(), numBytes) != 0)
+        bus.overwritten++;
+    bus.transactions++;
+    if (bus.dc_level == LOW)
+    {
+        bus.commands.insert(bus.commands.end(), bytes, bytes + numBytes);
+    } else {
+        bus.data.insert(bus.data.end(), bytes, bytes + numBytes);
+        bus.chunks.push_back(numBytes);
+        if (numBytes > PanelInterface::SLOT_SIZE)
+            bus.chunkBuffers.insert(bytes);
+    }
+    *trans = p.trans;
+    return ESP_OK;
+}
+
+static const int DC_PIN = 27;
+
+int gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num == DC_PIN)
+        bus.dc_level = level;
+    return 0;
+}
+
+// ***************************************************************************
+
+static PanelInterface *pIf;
+
+void setUp()
+{
+    bus.clear();
+}
+
+void tearDown()
+{
+    TEST_ASSERT_EQUAL_INT(0, (int) bus.pending.size());
+}
+
+static std::vector<uint8_t> pattern(size_t numBytes)
+{
+    std::vector<uint8_t> bytes(numBytes);
+    for (size_t i = 0; i < numBytes; i++)
+        bytes[i] = (uint8_t) (i * 7 + i / 251);
+    return bytes;
+}
+
+/// All chunks full except the last one, none larger than the capacity
+static void checkChunks(size_t numBytes)
+{
+    const size_t capacity = numBytes > PanelInterface::SLOT_SIZE ? PanelInterface::MAX_CHUNK_SIZE : PanelInterface::SLOT_SIZE;
+    TEST_ASSERT_EQUAL_size_t((numBytes + capacity - 1) / capacity, bus.chunks.size());
+    for (size_t i = 0; i + 1 < bus.chunks.size(); i++)
+        TEST_ASSERT_EQUAL_size_t(capacity, bus.chunks[i]);
+    TEST_ASSERT_LESS_OR_EQUAL(PanelInterface::TRANSFER_BUFFERS, (int) bus.chunkBuffers.size());
+    TEST_ASSERT_EQUAL_INT(0, bus.overwritten);
+    TEST_ASSERT_EQUAL_INT(0, bus.overflows);
+}
+
+static const size_t SMALL_LENGTHS[] = { 1, 2, 63, 64 };
+static const size_t LARGE_LENGTHS[] = { 65, 4091, 4092, 4093, 8184, 8185, 65535, 65536, 65537, 200000 };
+
+// ***************************************************************************
+
+/// Up to SLOT_SIZE bytes are copied into the transaction, no buffers are allocated
+void test_small_writes_use_slots()
+{
+    for (size_t numBytes : SMALL_LENGTHS)
+    {
+        bus.clear();
+        const std::vector<uint8_t> bytes = pattern(numBytes);
+        pIf->writeCommand(0x13, bytes.data(), numBytes);
+        pIf->flushQueue();
+        const uint8_t command[] = { 0x13 };
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(command, bus.commands.data(), 1);
+        TEST_ASSERT_TRUE(bus.data == bytes);
+        checkChunks(numBytes);
+    }
+    TEST_ASSERT_EQUAL_INT(0, transferAllocations);
+}
+
+void test_large_writes_in_order()
+{
+    for (size_t numBytes : LARGE_LENGTHS)
+    {
+        bus.clear();
+        const std::vector<uint8_t> bytes = pattern(numBytes);
+        pIf->writeCommand(0x10);
+        pIf->writeData(bytes.data(), numBytes);
+        pIf->flushQueue();
+        TEST_ASSERT_EQUAL_size_t(1, bus.commands.size());
+        TEST_ASSERT_TRUE(bus.data == bytes);
+        checkChunks(numBytes);
+    }
+    TEST_ASSERT_EQUAL_INT(PanelInterface::TRANSFER_BUFFERS, transferAllocations);
+}
+
+/// A fill prepares one buffer and queues it repeatedly
+void test_fills()
+{
+    for (size_t numBytes : SMALL_LENGTHS)
+    {
+        bus.clear();
+        pIf->writeData((uint8_t) 0xa5, numBytes);
+        pIf->flushQueue();
+        TEST_ASSERT_TRUE(bus.data == std::vector<uint8_t>(numBytes, 0xa5));
+        checkChunks(numBytes);
+    }
+    for (size_t numBytes : LARGE_LENGTHS)
+    {
+        bus.clear();
+        pIf->writeData((uint8_t) numBytes, numBytes);
+        pIf->flushQueue();
+        TEST_ASSERT_TRUE(bus.data == std::vector<uint8_t>(numBytes, (uint8_t) numBytes));
+        checkChunks(numBytes);
+        TEST_ASSERT_EQUAL_size_t(1, bus.chunkBuffers.size());
+    }
+    TEST_ASSERT_EQUAL_INT(PanelInterface::TRANSFER_BUFFERS, transferAllocations);
+}
+
+/// Rows of varying length queued back to back, the buffers alternate
+void test_streamed_rows_reuse_buffers()
+{
+    static const size_t ROW_LENGTHS[] = { 50, 100, 64, 65, 4092, 5000, 1, 12000 };
+    std::vector<uint8_t> expected;
+    pIf->writeCommand(0x13);
+    pIf->startDataTransfer();
+    for (int i = 0; i < 40; i++)
+    {
+        const size_t numBytes = ROW_LENGTHS[i % 8];
+        std::vector<uint8_t> row = pattern(numBytes + i);
+        row.erase(row.begin(), row.begin() + i);
+        expected.insert(expected.end(), row.begin(), row.end());
+        pIf->transferData(row.data(), numBytes);
+        // the caller reuses its row buffer at once
+        memset(row.data(), 0, numBytes);
+    }
+    pIf->endDataTransfer();
+
+    TEST_ASSERT_TRUE(bus.data == expected);
+    TEST_ASSERT_EQUAL_INT(PanelInterface::TRANSFER_BUFFERS, (int) bus.chunkBuffers.size());
+    TEST_ASSERT_EQUAL_INT(0, bus.overwritten);
+    TEST_ASSERT_EQUAL_INT(0, bus.overflows);
+    TEST_ASSERT_EQUAL_INT(PanelInterface::TRANSFER_BUFFERS, transferAllocations);
+}
+
+/// Byte by byte as before the chunking versus a single call, one plane each
+void test_throughput()
+{
+    static const size_t PLANES[] = { 400 * 300 / 8, 880 * 528 / 8 };
+    for (size_t numBytes : PLANES)
+    {
+        const std::vector<uint8_t> bytes = pattern(numBytes);
+
+        bus.clear();
+        auto start = std::chrono::steady_clock::now();
+        pIf->startDataTransfer();
+        for (size_t i = 0; i < numBytes; i++)
+            pIf->transferData(bytes[i]);
+        pIf->endDataTransfer();
+        const double bytewise_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        const int bytewiseTransactions = bus.transactions;
+        TEST_ASSERT_TRUE(bus.data == bytes);
+
+        bus.clear();
+        start = std::chrono::steady_clock::now();
+        pIf->startDataTransfer();
+        pIf->transferData(bytes.data(), numBytes);
+        pIf->endDataTransfer();
+        const double chunked_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        TEST_ASSERT_TRUE(bus.data == bytes);
+        TEST_ASSERT_EQUAL_INT((int) ((numBytes + PanelInterface::MAX_CHUNK_SIZE - 1) / PanelInterface::MAX_CHUNK_SIZE), bus.transactions);
+
+        char message[160];
+        snprintf(message, sizeof(message), "%u bytes: byte by byte %d transactions %.0f us, chunked %d transactions %.0f us",
+            (unsigned) numBytes, bytewiseTransactions, bytewise_us, bus.transactions, chunked_us);
+        TEST_MESSAGE(message);
+    }
+}
+
+// ***************************************************************************
+
+int main(int argc, char **argv)
+{
+    pIf = new PanelInterface(18, 19, 23, 5, DC_PIN, 26, 25);
+    pIf->init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_small_writes_use_slots);
+    RUN_TEST(test_large_writes_in_order);
+    RUN_TEST(test_fills);
+    RUN_TEST(test_streamed_rows_reuse_buffers);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
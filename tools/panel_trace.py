@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""
+ESP32 E-Paper display firmware
+Copyright (c) 2020 clausgf@github. See LICENSE.md for legal information.
+
+Decodes the "PanelTrace: <hex>" lines of a serial log (firmware built with
+-DPANEL_TRACE) into a timeline of the panel traffic.
+
+    pio device monitor | tee epd.log
+    tools/panel_trace.py epd.log
+"""
+
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<IIIBBH")
+TYPES = {0: "command", 1: "transaction", 2: "busy"}
+LINE = re.compile(r"PanelTrace: ((?:[0-9a-f]{%d})+)" % (2 * RECORD.size))
+
+
+def read_records(lines):
+    """Records of the last dump in the log"""
+    records = []
+    is_dump = False
+    for line in lines:
+        match = LINE.search(line)
+        if match is None:
+            is_dump = False
+            continue
+        if not is_dump:
+            records = []
+            is_dump = True
+        data = bytes.fromhex(match.group(1))
+        records.extend(RECORD.iter_unpack(data))
+    return records
+
+
+def main():
+    with open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin as f:
+        records = read_records(f)
+    if not records:
+        print("No trace records found")
+        return 1
+
+    t0 = records[0][0]
+    total = {"transaction": 0, "busy": 0}
+    for start_us, duration_us, length, type_, command, _ in records:
+        name = TYPES.get(type_, "type %d" % type_)
+        # micros() wraps after 71 minutes
+        offset_ms = (((start_us - t0 + 0x80000000) & 0xffffffff) - 0x80000000) / 1000.0
+        if name == "command":
+            print("%10.3f ms  command      0x%02x" % (offset_ms, command))
+            continue
+        total[name] = total.get(name, 0) + duration_us
+        print("%10.3f ms  %-12s 0x%02x %9.3f ms %7d B" % (offset_ms, name, command, duration_us / 1000.0, length))
+    print("transactions %.3f ms, busy %.3f ms" % (total["transaction"] / 1000.0, total["busy"] / 1000.0))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())